@@ -0,0 +1,120 @@
+#include "map.hpp"
+#include <iostream>
+#include <cassert>
+#include <map>
+#include <string>
+#include <vector>
+
+//	copying throws once armed counts down to zero
+class Payload {
+public:
+	static int alive;
+	static int armed;
+	std::string val;
+
+	Payload(const std::string &v) : val(v) { ++alive; }
+	Payload(const Payload &rhs) : val(rhs.val) {
+		if (armed > 0 && --armed == 0) throw std::string("copy failed");
+		++alive;
+	}
+	Payload &operator=(const Payload &rhs) {
+		val = rhs.val;
+		return *this;
+	}
+	~Payload() { --alive; }
+};
+
+int Payload::alive = 0;
+int Payload::armed = 0;
+
+typedef sjtu::map<int, Payload> payload_map;
+
+unsigned int seed = 78;
+
+int next_rand() {
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % 20000;
+}
+
+void check(const payload_map &map, const std::map<int, std::string> &ref) {
+	assert(map.size() == ref.size());
+	auto it = map.cbegin();
+	for (auto &p : ref) {
+		assert(it->first == p.first && it->second.val == p.second);
+		++it;
+	}
+	assert(it == map.cend());
+}
+
+//	one random batch, applied to the map at once and to ref one op at a
+//	time; the copy number arm inside apply_batch throws
+void run_batch(payload_map &map, std::map<int, std::string> &ref, size_t n, int step, int arm = 0) {
+	std::vector<payload_map::value_type> values;
+	std::vector<int> keys(n);
+	values.reserve(n);
+	std::vector<payload_map::batch_op> ops;
+	for (size_t i = 0; i < n; ++i) {
+		keys[i] = next_rand() % (n < 50 ? 200 : 20000);
+		values.push_back(payload_map::value_type(keys[i], Payload(std::to_string(step) + "." + std::to_string(i))));
+	}
+	for (size_t i = 0; i < n; ++i) {
+		if (next_rand() % 3) {
+			ops.push_back(payload_map::batch_op::insert(values[i]));
+			ref.insert(std::make_pair(keys[i], values[i].second.val)); // a present key is kept
+		} else {
+			ops.push_back(payload_map::batch_op::erase(keys[i]));
+			ref.erase(keys[i]);
+		}
+	}
+	Payload::armed = arm;
+	map.apply_batch(ops.data(), ops.size());
+	Payload::armed = 0;
+}
+
+void test_batches() {
+	payload_map map;
+	std::map<int, std::string> ref;
+	for (int step = 0; step < 400; ++step) {
+		size_t n = step % 4 == 0 ? 2000 : 1 + next_rand() % 40; // large and small paths
+		run_batch(map, ref, n, step);
+		check(map, ref);
+	}
+	std::cout << map.size() << std::endl;
+	//	the same key inserted, erased and inserted again within one batch
+	payload_map::value_type a(7, Payload("a")), b(7, Payload("b"));
+	int seven = 7;
+	payload_map::batch_op ops[] = {payload_map::batch_op::erase(seven), payload_map::batch_op::insert(a),
+	                               payload_map::batch_op::insert(b), payload_map::batch_op::erase(seven),
+	                               payload_map::batch_op::insert(b)};
+	map.apply_batch(ops, 5);
+	std::cout << map.at(7).val << " ";
+	map.apply_batch(ops, 0);
+	std::cout << map.at(7).val << std::endl;
+}
+
+//	a copy that throws halfway through either path leaves the map unchanged
+void test_all_or_nothing() {
+	payload_map map;
+	std::map<int, std::string> ref;
+	run_batch(map, ref, 3000, 0);
+	int failures = 0;
+	for (size_t n : {10, 30, 5000}) {
+		std::map<int, std::string> before = ref;
+		try {
+			run_batch(map, ref, n, 1, (int)n / 3);
+		} catch (std::string &) {
+			++failures;
+		}
+		Payload::armed = 0;
+		check(map, before);
+		ref = before;
+	}
+	std::cout << failures << " " << map.size() << std::endl;
+}
+
+int main() {
+	test_batches();
+	test_all_or_nothing();
+	std::cout << Payload::alive << std::endl;
+	return 0;
+}
@@ -0,0 +1,124 @@
+#include "backup_map.hpp"
+#include <iostream>
+#include <cassert>
+#include <cstdio>
+#include <map>
+#include <thread>
+#include <vector>
+
+typedef sjtu::backup_map<int, long> store;
+
+const int keys = 200000;
+const int writers = 4;
+const char *file = "backup_map.bin";
+
+unsigned int next_rand(unsigned int &seed) {
+	seed = seed * 1103515245u + 12345u;
+	return seed >> 8;
+}
+
+//	writer id owns the keys equal to id modulo writers, so the final
+//	contents can be replayed without the threads
+void write_ops(store *map, std::map<int, long> *mine, int id) {
+	unsigned int seed = 99 + id;
+	for (int step = 0; step < 60000; ++step) {
+		int key = next_rand(seed) % (keys + keys / 4) / writers * writers + id;
+		int op = next_rand(seed) % 3;
+		if (op == 0) {
+			map->assign(key, -step);
+			(*mine)[key] = -step;
+		} else if (op == 1) {
+			bool inserted = map->insert(key, step);
+			assert(inserted == mine->insert(std::make_pair(key, step)).second);
+		} else {
+			assert(map->erase(key) == (mine->erase(key) == 1));
+		}
+	}
+}
+
+std::map<int, long> read_back() {
+	sjtu::map<int, long> loaded;
+	std::FILE *in = std::fopen(file, "rb");
+	assert(in);
+	loaded.read_snapshot(in);
+	std::fclose(in);
+	std::map<int, long> out;
+	for (auto it = loaded.cbegin(); it != loaded.cend(); ++it) out.insert(std::make_pair(it->first, it->second));
+	return out;
+}
+
+//	writers on every part of the key range while the backup runs: the
+//	file holds exactly the contents at start_backup(), the map the writes
+void test_concurrent_writers() {
+	store map;
+	std::map<int, long> at_start;
+	for (int i = 0; i < keys; i += 2) {
+		map.insert(i, i);
+		at_start[i] = i;
+	}
+	std::vector<std::map<int, long>> owned(writers);
+	for (auto &p : at_start) owned[p.first % writers].insert(p);
+	map.start_backup(file);
+	std::vector<std::thread> threads;
+	for (int id = 0; id < writers; ++id) threads.emplace_back(write_ops, &map, &owned[id], id);
+	for (auto &t : threads) t.join();
+	store::backup_report report = map.wait_backup();
+	assert(!map.backup_running());
+	std::cout << report.records << " " << (read_back() == at_start) << std::endl;
+	size_t expect = 0;
+	bool same = true;
+	for (int id = 0; id < writers; ++id) {
+		expect += owned[id].size();
+		for (auto &p : owned[id]) {
+			long value;
+			same = same && map.get(p.first, value) && value == p.second;
+		}
+	}
+	std::cout << (map.size() == expect) << " " << same << std::endl;
+}
+
+//	racing start_backup calls: exactly one wins, the rest throw
+void test_racing_starts() {
+	store map;
+	for (int i = 0; i < 1000; ++i) map.insert(i, i * 3);
+	int won = 0, lost = 0;
+	std::mutex count;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 8; ++t) threads.emplace_back([&] {
+		try {
+			map.start_backup(file);
+			std::lock_guard<std::mutex> guard(count);
+			++won;
+		} catch (sjtu::runtime_error &) {
+			std::lock_guard<std::mutex> guard(count);
+			++lost;
+		}
+	});
+	for (auto &t : threads) t.join();
+	store::backup_report report = map.wait_backup();
+	std::cout << won << " " << lost << " " << report.records << " " << read_back().size() << std::endl;
+	try {
+		map.wait_backup();
+		assert(false);
+	} catch (sjtu::runtime_error &) {}
+}
+
+//	insert on a present key changes nothing, so it saves no preimage
+void test_insert_existing() {
+	store map;
+	for (int i = 0; i < keys; ++i) map.insert(i, i);
+	map.start_backup(file);
+	int refused = 0;
+	for (int i = keys - 1; i >= 0; i -= 7) refused += !map.insert(i, -1);
+	store::backup_report report = map.wait_backup();
+	long value;
+	std::cout << refused << " " << report.preimages << " " << (map.get(keys - 1, value) && value == keys - 1) << std::endl;
+}
+
+int main() {
+	test_concurrent_writers();
+	test_racing_starts();
+	test_insert_existing();
+	std::remove(file);
+	return 0;
+}
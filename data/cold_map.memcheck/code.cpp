@@ -0,0 +1,134 @@
+#include "cold_map.hpp"
+#include <iostream>
+#include <cassert>
+#include <map>
+
+unsigned int seed = 100;
+
+unsigned int next_rand() {
+	seed = seed * 1103515245u + 12345u;
+	return seed >> 8;
+}
+
+struct collector {
+	std::map<long long, long long> *out;
+	long long *last;
+	void operator()(const long long &key, const long long &value) const {
+		assert(out->empty() || *last < key); // key order
+		*last = key;
+		out->insert(std::make_pair(key, value));
+	}
+};
+
+template<class Map>
+bool same(const Map &map, const std::map<long long, long long> &ref) {
+	std::map<long long, long long> seen;
+	long long last = 0;
+	map.for_each(collector{&seen, &last});
+	if (seen != ref || map.size() != ref.size()) return false;
+	for (auto &p : ref) {
+		long long value;
+		if (!map.count(p.first) || !map.get(p.first, value) || value != p.second) return false;
+	}
+	return true;
+}
+
+//	everything goes cold and comes back unchanged, with sequential,
+//	gapped and incompressible keys and values
+void test_round_trip() {
+	for (int kind = 0; kind < 3; ++kind) {
+		sjtu::cold_map<long long, long long> map(128);
+		std::map<long long, long long> ref;
+		for (int i = 0; i < 20000; ++i) {
+			long long key, value;
+			if (kind == 0) key = i, value = i * 2;
+			else if (kind == 1) key = i * 1000003LL - 7000000000LL, value = -i;
+			else key = (long long)next_rand() << 40 ^ next_rand(), value = (long long)next_rand() * next_rand() - (1LL << 40);
+			map[key] = value;
+			ref[key] = value;
+		}
+		size_t moved = map.compact_cold(0);
+		sjtu::cold_map<long long, long long>::memory_report r = map.memory();
+		std::cout << moved << " " << r.hot_entries << " " << r.cold_blocks << " " << (r.cold_packed_bytes < r.cold_raw_bytes) << " ";
+		assert(same(map, ref));
+		//	a second pass finds nothing left to pack
+		assert(map.compact_cold(0) == 0);
+		map.thaw_all();
+		r = map.memory();
+		std::cout << r.hot_entries << " " << r.cold_blocks << " " << same(map, ref) << std::endl;
+	}
+}
+
+//	writes into cold ranges thaw them; recent keys stay hot
+void test_thaw_on_write() {
+	sjtu::cold_map<long long, long long> map(64);
+	std::map<long long, long long> ref;
+	for (long long i = 0; i < 10000; ++i) {
+		map.insert(i * 2, i);
+		ref[i * 2] = i;
+	}
+	for (long long i = 9000; i < 10000; ++i) map.at(i * 2) += 0; // touch the tail
+	size_t moved = map.compact_cold(1000);
+	assert(!map.insert(100, 0)); // present and cold: refused, block thawed
+	assert(map.insert(101, 1));  // inside a cold range: thaws, then inserts
+	ref[101] = 1;
+	map[5001] = 5;
+	ref[5001] = 5;
+	assert(map.erase(7000) && ref.erase(7000));
+	assert(!map.erase(7001));
+	map.at(12000) = -1;
+	ref[12000] = -1;
+	try {
+		map.at(12001);
+		assert(false);
+	} catch (sjtu::index_out_of_bound &) {}
+	sjtu::cold_map<long long, long long>::memory_report r = map.memory();
+	std::cout << moved << " " << r.cold_entries << " " << r.cold_blocks << " " << same(map, ref) << std::endl;
+}
+
+//	keys that are only read stay hot as well
+void test_reads_keep_hot() {
+	sjtu::cold_map<long long, long long> map(64);
+	for (long long i = 0; i < 10000; ++i) map.insert(i, i * 3);
+	long long sum = 0, value;
+	for (int round = 0; round < 3; ++round) {
+		for (long long i = 9000; i < 9500; ++i) {
+			assert(map.get(i, value));
+			sum += value;
+		}
+		for (long long i = 9500; i < 10000; ++i) sum += map.count(i);
+	}
+	size_t moved = map.compact_cold(1000);
+	sjtu::cold_map<long long, long long>::memory_report r = map.memory();
+	std::cout << moved << " " << r.hot_entries << " " << sum << std::endl;
+}
+
+void test_random() {
+	sjtu::cold_map<long long, long long> map(32);
+	std::map<long long, long long> ref;
+	size_t compacted = 0;
+	for (int step = 0; step < 100000; ++step) {
+		long long key = next_rand() % 6000, value = step;
+		int op = next_rand() % 6;
+		if (op == 0) assert(map.insert(key, value) == ref.insert(std::make_pair(key, value)).second);
+		else if (op == 1) map[key] = ref[key] = value;
+		else if (op == 2) assert(map.erase(key) == (ref.erase(key) == 1));
+		else if (op == 3) {
+			long long got;
+			assert(map.get(key, got) == (ref.count(key) == 1));
+			if (ref.count(key)) assert(got == ref[key] && map.at(key) == got);
+		} else assert(map.count(key) == ref.count(key));
+		if (step % 5000 == 4999) compacted += map.compact_cold(3000);
+	}
+	std::cout << map.size() << " " << (compacted > 0) << " " << same(map, ref) << " ";
+	map.clear();
+	std::cout << map.size() << " " << map.memory().cold_blocks << std::endl;
+}
+
+int main() {
+	test_round_trip();
+	test_thaw_on_write();
+	test_reads_keep_hot();
+	test_random();
+	return 0;
+}
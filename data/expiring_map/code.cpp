@@ -0,0 +1,154 @@
+#include "expiring_map.hpp"
+#include <iostream>
+#include <cassert>
+#include <map>
+#include <utility>
+
+typedef sjtu::expiring_map<int, int> cache;
+
+//	copies and assignments throw once budget runs out
+class Fragile {
+public:
+	static int budget;
+	int val;
+
+	Fragile(int val) : val(val) {}
+
+	Fragile(const Fragile &rhs) : val(rhs.val) {
+		if (budget >= 0 && budget-- == 0) throw 1;
+	}
+
+	Fragile &operator = (const Fragile &rhs) {
+		if (budget >= 0 && budget-- == 0) throw 1;
+		val = rhs.val;
+		return *this;
+	}
+};
+
+int Fragile::budget = -1;
+typedef unsigned long long time_type;
+
+unsigned int seed = 79;
+
+int next_rand() {
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % 3000;
+}
+
+//	model: key -> (value, expiry), expired entries kept until swept or
+//	looked up, as the map does
+typedef std::map<int, std::pair<int, time_type>> model;
+
+bool live(model &ref, int key, time_type now) {
+	auto it = ref.find(key);
+	if (it == ref.end()) return false;
+	if (it->second.second <= now) {
+		ref.erase(it);
+		return false;
+	}
+	return true;
+}
+
+struct collector {
+	std::map<int, int> *out;
+	void operator()(const int &key, const int &value) const { out->insert(std::make_pair(key, value)); }
+};
+
+void test_random() {
+	cache map;
+	model ref;
+	time_type now = 0;
+	size_t swept = 0;
+	for (int step = 0; step < 200000; ++step) {
+		now += next_rand() % 3;
+		int key = next_rand(), op = next_rand() % 7;
+		time_type expires = now + 1 + next_rand() % 400;
+		if (op == 0) {
+			bool fresh = !live(ref, key, now);
+			assert(map.insert(sjtu::pair<const int, int>(key, step), expires, now) == fresh);
+			if (fresh) ref[key] = std::make_pair(step, expires);
+		} else if (op == 1) {
+			map.put(key, step, expires);
+			ref[key] = std::make_pair(step, expires);
+		} else if (op == 2) {
+			bool there = live(ref, key, now);
+			assert(map.touch(key, expires, now) == there);
+			if (there) ref[key].second = expires;
+		} else if (op == 3) {
+			assert(map.erase(key) == (ref.erase(key) == 1));
+		} else if (op == 4) {
+			int *value = map.find(key, now);
+			assert((value != nullptr) == live(ref, key, now));
+			if (value) assert(*value == ref[key].first);
+		} else if (op == 5) {
+			assert(map.count(key, now) == (live(ref, key, now) ? 1u : 0u));
+		} else if (step % 50 == 0) {
+			size_t expired = 0;
+			for (auto it = ref.begin(); it != ref.end();) {
+				if (it->second.second <= now) {
+					it = ref.erase(it);
+					++expired;
+				} else ++it;
+			}
+			assert(map.expire_until(now) == expired);
+			swept += expired;
+		}
+		assert(map.size() == ref.size());
+		if (step % 97 == 0 && !ref.empty()) {
+			time_type first = ref.begin()->second.second;
+			for (auto &p : ref) first = p.second.second < first ? p.second.second : first;
+			assert(map.next_expiry() == first);
+		}
+	}
+	std::map<int, int> seen, expect;
+	map.for_each(now, collector{&seen});
+	for (auto &p : ref)
+		if (p.second.second > now) expect[p.first] = p.second.first;
+	std::cout << map.size() << " " << swept << " " << (seen == expect) << std::endl;
+}
+
+//	a sweep far in the future empties it, and an empty map has no expiry
+void test_drain() {
+	cache map;
+	for (int i = 0; i < 1000; ++i) map.put(i, i, 1000 - i);
+	assert(map.next_expiry() == 1);
+	std::cout << map.expire_until(500) << " " << map.next_expiry() << " ";
+	std::cout << map.expire_until(~0ULL) << " " << map.empty() << std::endl;
+	try {
+		map.next_expiry();
+		assert(false);
+	} catch (sjtu::container_is_empty &) {}
+	map.put(1, 1, 10);
+	map.clear();
+	std::cout << map.size() << " " << map.expire_until(~0ULL) << std::endl;
+}
+
+//	a put that throws part-way keeps the entry it was replacing
+void test_put_failure() {
+	sjtu::expiring_map<int, Fragile> map;
+	for (int i = 0; i < 10; ++i) map.put(i, Fragile(i), 100 + i);
+	int failed = 0;
+	for (int fail_at = 0; fail_at < 8; ++fail_at) {
+		Fragile::budget = fail_at;
+		try {
+			map.put(5, Fragile(50), 7);
+			Fragile::budget = -1;
+			break;
+		} catch (int) {
+			Fragile::budget = -1;
+			++failed;
+			//	value and expiry (105, not 7) as before, and no stray deadline
+			assert(map.size() == 10 && map.find(5, 104)->val == 5 && map.next_expiry() == 100);
+		}
+	}
+	//	the successful put moved both the value and the expiry
+	std::cout << failed << " " << map.find(5, 6)->val << " " << map.next_expiry() << " " << map.expire_until(7) << " ";
+	std::cout << map.expire_until(~0ULL) << " " << map.empty() << std::endl;
+}
+
+int main() {
+	test_random();
+	test_drain();
+	test_put_failure();
+	return 0;
+}
@@ -0,0 +1,93 @@
+#include "map.hpp"
+#include <iostream>
+#include <cassert>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef sjtu::map<int, std::string> str_map;
+
+unsigned int seed = 85;
+
+int next_rand() {
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % 30000;
+}
+
+//	exports lo <= key < hi in chunks of max and compares with the reference
+void test_chunks(const str_map &map, const std::map<int, std::string> &ref) {
+	int keys[64];
+	std::string values[64];
+	for (int round = 0; round < 2000; ++round) {
+		int lo = next_rand() - 500, hi = round % 20 == 0 ? lo - 3 : lo + next_rand() % 3000;
+		size_t max = 1 + round % 64;
+		str_map::export_cursor cursor = map.export_begin(lo, hi);
+		auto it = ref.lower_bound(lo);
+		size_t total = 0;
+		for (;;) {
+			size_t n = map.export_range(cursor, keys, round % 3 ? values : nullptr, max);
+			assert(n <= max);
+			for (size_t i = 0; i < n; ++i, ++it) {
+				assert(it != ref.end() && it->first < hi && keys[i] == it->first);
+				if (round % 3) assert(values[i] == it->second);
+			}
+			total += n;
+			if (n < max) break;
+		}
+		assert(cursor.done());
+		assert(it == ref.end() || it->first >= hi || lo >= hi);
+		if (lo < hi) assert(total == (size_t)std::distance(ref.lower_bound(lo), ref.lower_bound(hi)));
+		else assert(total == 0);
+	}
+}
+
+void test_all() {
+	str_map map;
+	std::map<int, std::string> ref;
+	for (int i = 0; i < 20000; ++i) {
+		int key = next_rand();
+		std::string value = std::to_string(i * 7);
+		map[key] = value;
+		ref[key] = value;
+	}
+	test_chunks(map, ref);
+	//	a whole-map cursor survives inserts and erases elsewhere
+	str_map::export_cursor cursor = map.export_begin();
+	std::vector<int> out;
+	int keys[100];
+	size_t n = map.export_range(cursor, keys, nullptr, 100);
+	out.insert(out.end(), keys, keys + n);
+	int next = ref.upper_bound(keys[n - 1])->first;
+	for (int i = 0; i < 300; ++i) {
+		int key = next_rand();
+		if (key == next) continue;
+		if (i % 2) {
+			map[key] = "new";
+			ref[key] = "new";
+		} else if (ref.count(key)) {
+			map.erase(map.find(key));
+			ref.erase(key);
+		}
+	}
+	while ((n = map.export_range(cursor, keys, nullptr, 100))) out.insert(out.end(), keys, keys + n);
+	//	everything up to the first chunk as it was, after it as it is now
+	size_t tail = std::distance(ref.lower_bound(next), ref.end());
+	std::cout << out.size() << " " << (out.size() == 100 + tail) << " " << cursor.done() << std::endl;
+	//	values only, from the one-shot overload
+	std::string values[5];
+	n = map.export_range(ref.begin()->first, ref.rbegin()->first + 1, nullptr, values, 5);
+	std::cout << n << " " << (values[0] == ref.begin()->second) << std::endl;
+	str_map other;
+	try {
+		other.export_range(cursor, keys, nullptr, 1);
+		assert(false);
+	} catch (sjtu::invalid_iterator &) {}
+	str_map::export_cursor empty = other.export_begin();
+	std::cout << empty.done() << " " << other.export_range(empty, keys, values, 5) << std::endl;
+}
+
+int main() {
+	test_all();
+	return 0;
+}
@@ -0,0 +1,68 @@
+#include "map.hpp"
+#include <iostream>
+#include <cassert>
+#include <map>
+#include <vector>
+
+typedef sjtu::map<int, long long> int_map;
+
+unsigned int seed = 84;
+
+int next_rand() {
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % 100000;
+}
+
+//	ranges of every shape, including empty and inverted ones
+void test_ranges(const int_map &map, const std::map<int, long long> &ref) {
+	for (int round = 0; round < 3000; ++round) {
+		int lo = next_rand() - 1000, hi = round % 10 == 0 ? lo : lo + next_rand() % (round % 3 ? 500 : 50000);
+		if (round % 50 == 0) hi = lo - 1;
+		std::vector<int> seen;
+		map.for_each(lo, hi, [&seen](const int_map::value_type &v) { seen.push_back(v.first); });
+		auto it = ref.lower_bound(lo);
+		size_t i = 0;
+		for (; lo < hi && it != ref.end() && it->first < hi; ++it, ++i) assert(i < seen.size() && seen[i] == it->first);
+		assert(i == seen.size());
+		//	stop after at most five elements
+		int visited = 0;
+		bool whole = map.for_each_while(lo, hi, [&visited](const int_map::value_type &) { return ++visited < 5; });
+		assert(whole == (seen.size() < 5) && visited == (int)(seen.size() < 5 ? seen.size() : 5));
+	}
+}
+
+void test_all() {
+	int_map map;
+	std::map<int, long long> ref;
+	for (int i = 0; i < 50000; ++i) {
+		int key = next_rand();
+		map[key] = i;
+		ref[key] = i;
+	}
+	test_ranges(map, ref);
+	//	writes through the non-const overloads
+	map.for_each([](int_map::value_type &v) { v.second = v.second * 3 + v.first; });
+	for (auto &p : ref) p.second = p.second * 3 + p.first;
+	map.for_each(20000, 30000, [](int_map::value_type &v) { v.second = -v.second; });
+	for (auto it = ref.lower_bound(20000); it != ref.end() && it->first < 30000; ++it) it->second = -it->second;
+	long long sum = 0, expect = 0;
+	const int_map &view = map;
+	view.for_each([&sum](const int_map::value_type &v) { sum += v.second; });
+	for (auto &p : ref) expect += p.second;
+	auto it = ref.begin();
+	bool same = true;
+	map.for_each([&it, &same](int_map::value_type &v) {
+		same = same && v.first == it->first && v.second == it->second;
+		++it;
+	});
+	std::cout << map.size() << " " << (sum == expect) << " " << same << " " << (it == ref.end()) << std::endl;
+	int_map empty;
+	int calls = 0;
+	empty.for_each([&calls](int_map::value_type &) { ++calls; });
+	std::cout << calls << " " << empty.for_each_while(0, 10, [](int_map::value_type &) { return false; }) << std::endl;
+}
+
+int main() {
+	test_all();
+	return 0;
+}
@@ -0,0 +1,65 @@
+#include "map.hpp"
+#include "huge_page_arena.hpp"
+#include <iostream>
+#include <cassert>
+#include <map>
+
+typedef sjtu::map<long, long, std::less<long>, sjtu::huge_page_alloc> huge_map;
+
+unsigned int seed = 88;
+
+long next_rand() {
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % 300000;
+}
+
+void run(bool use_huge) {
+	sjtu::huge_page_alloc alloc(4 * sjtu::huge_page_arena::huge_page, use_huge);
+	huge_map map(alloc);
+	std::map<long, long> ref;
+	for (int i = 0; i < 200000; ++i) {
+		long key = next_rand();
+		map[key] = i;
+		ref[key] = i;
+	}
+	size_t reserved = alloc.arena().reserved();
+	//	erase half, then insert as many again: freed blocks are reused
+	int erased = 0;
+	for (auto it = ref.begin(); it != ref.end();) {
+		if (erased++ % 2) {
+			map.erase(map.find(it->first));
+			it = ref.erase(it);
+		} else ++it;
+	}
+	for (long i = 0; i < 50000; ++i) {
+		map[-1 - i] = i;
+		ref[-1 - i] = i;
+	}
+	std::cout << (alloc.arena().reserved() == reserved) << " " << (reserved % sjtu::huge_page_arena::huge_page) << std::endl;
+	//	copies, split and join share the arena
+	huge_map copy(map), upper(alloc);
+	copy.split(150000, upper);
+	copy.join(upper);
+	assert(copy.size() == ref.size() && map.size() == ref.size());
+	auto it = copy.cbegin();
+	for (auto &p : ref) {
+		assert(it->first == p.first && it->second == p.second);
+		++it;
+	}
+	std::cout << map.size() << " " << alloc.arena().huge_pages() << std::endl;
+}
+
+int main() {
+	run(true);
+	run(false);
+	//	the arena goes away with the last map using it
+	huge_map *outlive;
+	{
+		sjtu::huge_page_alloc alloc;
+		outlive = new huge_map(alloc);
+	}
+	for (long i = 0; i < 1000; ++i) (*outlive)[i] = i;
+	std::cout << outlive->size() << std::endl;
+	delete outlive;
+	return 0;
+}
@@ -0,0 +1,172 @@
+#include "lean_map.hpp"
+#include <iostream>
+#include <cassert>
+#include <map>
+
+unsigned int seed = 95;
+
+int next_rand() {
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % 4000;
+}
+
+void check(const sjtu::lean_map<int, int> &map, const std::map<int, int> &ref) {
+	assert(map.size() == ref.size());
+	auto it = map.cbegin();
+	for (auto &p : ref) {
+		assert(it->first == p.first && it->second == p.second);
+		++it;
+	}
+	assert(it == map.cend());
+	//	and backwards from end()
+	for (auto r = ref.rbegin(); r != ref.rend(); ++r) {
+		--it;
+		assert((*it).first == r->first);
+	}
+}
+
+//	the iterator insert returns walks both ways from the new element
+void test_iterate_after_insert() {
+	sjtu::lean_map<int, int> map;
+	std::map<int, int> ref;
+	long long walked = 0;
+	for (int step = 0; step < 20000; ++step) {
+		int key = next_rand();
+		auto res = map.insert(sjtu::pair<const int, int>(key, step));
+		auto expect = ref.insert(std::make_pair(key, step));
+		assert(res.second == expect.second && res.first->second == expect.first->second);
+		auto it = res.first;
+		auto r = expect.first;
+		for (int i = 0; i < 5 && r != ref.end(); ++i, ++it, ++r, ++walked) assert(it->first == r->first);
+		if (r == ref.end()) assert(it == map.end());
+		it = res.first;
+		r = expect.first;
+		for (int i = 0; i < 5 && r != ref.begin(); ++i, ++walked) {
+			--it;
+			--r;
+			assert(it->first == r->first);
+		}
+	}
+	check(map, ref);
+	std::cout << map.size() << " " << walked << std::endl;
+}
+
+//	erase, then iterate again from fresh iterators
+void test_iterate_after_erase() {
+	sjtu::lean_map<int, int> map;
+	std::map<int, int> ref;
+	for (int i = 0; i < 10000; ++i) {
+		map[i] = i;
+		ref[i] = i;
+	}
+	for (int round = 0; round < 4; ++round) {
+		//	every key found by a fresh find is erased through its iterator
+		for (int i = round; i < 10000; i += 4 + round) {
+			auto it = map.find(i);
+			if (it == map.end()) continue;
+			map.erase(it);
+			ref.erase(i);
+		}
+		check(map, ref);
+		for (int i = 0; i < 1000; ++i) {
+			int key = next_rand();
+			assert(map.erase(key) == (ref.erase(key) == 1));
+		}
+		check(map, ref);
+		std::cout << map.size() << " ";
+	}
+	std::cout << std::endl;
+}
+
+//	iterators from before a change throw instead of walking a stale path
+void test_stale() {
+	sjtu::lean_map<int, int> map;
+	for (int i = 0; i < 100; ++i) map[i] = i;
+	int thrown = 0;
+	auto it = map.find(50);
+	map[200] = 0;
+	try { ++it; } catch (sjtu::invalid_iterator &) { ++thrown; }
+	it = map.find(50);
+	map.erase(7);
+	try { *it; } catch (sjtu::invalid_iterator &) { ++thrown; }
+	//	a missing key counts as a change too
+	it = map.find(50);
+	map.erase(1000);
+	try { map.erase(it); } catch (sjtu::invalid_iterator &) { ++thrown; }
+	auto last = map.end();
+	map.insert(sjtu::pair<const int, int>(50, 1));
+	try { --last; } catch (sjtu::invalid_iterator &) { ++thrown; }
+	auto first = map.begin();
+	map.clear();
+	try { ++first; } catch (sjtu::invalid_iterator &) { ++thrown; }
+	sjtu::lean_map<int, int>::iterator none;
+	try { ++none; } catch (sjtu::invalid_iterator &) { ++thrown; }
+	std::cout << thrown << " " << map.size() << std::endl;
+}
+
+//	paths far deeper than the iterator's window of nodes
+void test_deep_paths() {
+	sjtu::lean_map<int, int> map;
+	std::map<int, int> ref;
+	for (int i = 0; i < 200000; ++i) {
+		int key = (int)(i * 2654435761u % 1000003u);
+		auto res = map.insert(sjtu::pair<const int, int>(key, i));
+		assert(res.second == ref.insert(std::make_pair(key, i)).second);
+		auto it = res.first;
+		if (i % 1000 == 0) {
+			auto r = ref.find(key);
+			for (int k = 0; k < 40 && r != ref.begin(); ++k) {
+				--it;
+				--r;
+				assert(it->first == r->first);
+			}
+		}
+	}
+	check(map, ref);
+	long long walked = 0;
+	for (int i = 0; i < 2000; ++i) {
+		int key = (int)(i * 97u * 2654435761u % 1000003u); //	inserted above
+		auto it = map.find(key);
+		auto r = ref.find(key);
+		assert((it == map.end()) == (r == ref.end()));
+		for (int k = 0; k < 50 && r != ref.end(); ++k, ++it, ++r, ++walked) assert(it->first == r->first);
+	}
+	std::cout << map.size() << " " << walked << " " << (sizeof(sjtu::lean_map<int, int>::iterator) < 200) << std::endl;
+}
+
+void test_random() {
+	sjtu::lean_map<int, int> map;
+	std::map<int, int> ref;
+	for (int step = 0; step < 200000; ++step) {
+		int key = next_rand(), op = next_rand() % 5;
+		if (op < 2) {
+			bool inserted = map.insert(sjtu::pair<const int, int>(key, step)).second;
+			assert(inserted == ref.insert(std::make_pair(key, step)).second);
+		} else if (op == 2) {
+			map[key] += step;
+			ref[key] += step;
+		} else if (op == 3) {
+			assert(map.erase(key) == (ref.erase(key) == 1));
+		} else {
+			assert(map.count(key) == ref.count(key));
+			if (ref.count(key)) assert(map.at(key) == ref[key] && map.find(key)->second == ref[key]);
+			else assert(map.find(key) == map.end());
+		}
+	}
+	check(map, ref);
+	sjtu::lean_map<int, int> copy(map);
+	map.clear();
+	check(copy, ref);
+	map = copy;
+	check(map, ref);
+	std::cout << map.size() << " " << map.begin()->first << std::endl;
+}
+
+int main() {
+	test_iterate_after_insert();
+	test_iterate_after_erase();
+	test_stale();
+	test_deep_paths();
+	test_random();
+	return 0;
+}
@@ -0,0 +1,131 @@
+#include "lru_map.hpp"
+#include <iostream>
+#include <cassert>
+#include <list>
+#include <map>
+
+unsigned int seed = 80;
+
+int next_rand() {
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % 200;
+}
+
+//	a value whose copies can be made to fail
+class Fragile {
+public:
+	static int budget;
+	int val;
+
+	Fragile(int val) : val(val) {}
+
+	Fragile(const Fragile &rhs) : val(rhs.val) {
+		if (budget >= 0 && budget-- == 0) throw 1;
+	}
+
+	Fragile &operator = (const Fragile &rhs) {
+		if (budget >= 0 && budget-- == 0) throw 1;
+		val = rhs.val;
+		return *this;
+	}
+};
+
+int Fragile::budget = -1;
+
+//	recency order kept in a std::list, newest first
+struct model {
+	size_t cap;
+	std::map<int, int> values;
+	std::list<int> order;
+
+	void use(int key) {
+		order.remove(key);
+		order.push_front(key);
+	}
+
+	void put(int key, int val) {
+		values[key] = val;
+		use(key);
+		if (values.size() > cap) {
+			values.erase(order.back());
+			order.pop_back();
+		}
+	}
+};
+
+void test_against_model() {
+	sjtu::lru_map<int, int> map(50);
+	model ref;
+	ref.cap = 50;
+	long long hits = 0;
+	for (int step = 0; step < 100000; ++step) {
+		int key = next_rand(), op = next_rand() % 4;
+		if (op == 0) {
+			int *v = map.find(key);
+			assert((v != nullptr) == (ref.values.count(key) == 1));
+			if (v) {
+				assert(*v == ref.values[key]);
+				ref.use(key);
+				++hits;
+			}
+		} else if (op == 1) {
+			map.put(key, step);
+			ref.put(key, step);
+		} else if (op == 2) {
+			bool inserted = map.insert(sjtu::pair<const int, int>(key, step));
+			assert(inserted == (ref.values.count(key) == 0));
+			if (inserted) ref.put(key, step);
+			else ref.use(key);
+		} else {
+			assert(map.erase(key) == (ref.values.erase(key) == 1));
+			ref.order.remove(key);
+		}
+		assert(map.size() == ref.values.size());
+		if (!ref.order.empty()) assert(map.lru_key() == ref.order.back());
+	}
+	auto it = map.begin();
+	for (auto &p : ref.values) {
+		assert(it.key() == p.first && it.value() == p.second);
+		++it;
+	}
+	assert(it == map.end());
+	std::cout << map.size() << " " << hits << std::endl;
+	map.set_capacity(10);
+	std::cout << map.size() << " " << map.lru_key() << std::endl;
+}
+
+//	a failed insert into a full map must not have evicted anything
+void test_strong_guarantee() {
+	sjtu::lru_map<int, Fragile> map(3);
+	for (int i = 1; i <= 3; ++i) map.put(i, Fragile(i * 10));
+	for (int fail_at = 0; fail_at < 8; ++fail_at) {
+		Fragile::budget = fail_at;
+		try {
+			map.put(4, Fragile(40));
+			Fragile::budget = -1;
+			std::cout << "put ok after " << fail_at << std::endl;
+			break;
+		} catch (int) {
+			Fragile::budget = -1;
+			assert(map.size() == 3 && map.lru_key() == 1 && !map.peek(4));
+			for (int i = 1; i <= 3; ++i) assert(map.peek(i)->val == i * 10);
+		}
+	}
+	std::cout << map.size() << " " << map.lru_key() << " " << map.count(1) << std::endl;
+	//	replacing a value never evicts
+	Fragile::budget = 0;
+	try {
+		map.put(2, Fragile(0));
+		assert(false);
+	} catch (int) {}
+	Fragile::budget = -1;
+	std::cout << map.size() << " " << map.peek(2)->val << " " << map.lru_key() << std::endl;
+	map.put(2, Fragile(21));
+	std::cout << map.size() << " " << map.peek(2)->val << " " << map.lru_key() << std::endl;
+}
+
+int main() {
+	test_against_model();
+	test_strong_guarantee();
+	return 0;
+}
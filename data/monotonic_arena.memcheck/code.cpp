@@ -0,0 +1,79 @@
+#include "map.hpp"
+#include "monotonic_arena.hpp"
+#include <iostream>
+#include <cassert>
+#include <map>
+#include <string>
+
+typedef sjtu::map<int, int, std::less<int>, sjtu::arena_alloc> scratch_map;
+typedef sjtu::map<int, std::string, std::less<int>, sjtu::arena_alloc> scratch_names;
+
+unsigned int seed = 91;
+
+int next_rand() {
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % 100000;
+}
+
+//	one request: build, query and drop a scratch map
+long long request(sjtu::monotonic_arena &arena, int entries) {
+	scratch_map map{sjtu::arena_alloc(arena)};
+	std::map<int, int> ref;
+	for (int i = 0; i < entries; ++i) {
+		int key = next_rand();
+		map[key] = i;
+		ref[key] = i;
+	}
+	for (int i = 0; i < entries / 4; ++i) {
+		int key = next_rand();
+		auto it = map.find(key);
+		if (it != map.end()) {
+			map.erase(it);
+			ref.erase(key);
+		}
+	}
+	assert(map.size() == ref.size());
+	long long sum = 0;
+	auto it = map.cbegin();
+	for (auto &p : ref) {
+		assert(it->first == p.first && it->second == p.second);
+		sum += p.second;
+		++it;
+	}
+	return sum % 1000003;
+}
+
+int main() {
+	sjtu::monotonic_arena arena(1024);
+	for (int entries : {1000, 10000, 100000}) {
+		long long total = 0;
+		for (int r = 0; r < 5; ++r) {
+			total += request(arena, entries);
+			arena.reset();
+			assert(arena.used() == 0);
+		}
+		std::cout << entries << " " << total << std::endl;
+	}
+	//	clear() drops trivially copyable nodes at once; the map stays usable
+	{
+		scratch_map map{sjtu::arena_alloc(arena)};
+		for (int i = 0; i < 1000; ++i) map[i] = i;
+		size_t used = arena.used();
+		map.clear();
+		std::cout << map.size() << " " << (arena.used() == used) << std::endl;
+		for (int i = 0; i < 10; ++i) map[i] = i;
+		std::cout << map.size() << " " << map.at(9) << std::endl;
+	}
+	arena.reset();
+	//	values that own memory are still destroyed, only not freed one by one
+	{
+		scratch_names names{sjtu::arena_alloc(arena)};
+		for (int i = 0; i < 1000; ++i) names[i] = std::string(100, 'a' + i % 26);
+		scratch_names copy(names);
+		names.clear();
+		std::cout << copy.size() << " " << copy.at(27) << std::endl;
+	}
+	arena.release();
+	std::cout << arena.used() << std::endl;
+	return 0;
+}
@@ -0,0 +1,104 @@
+#include "multimap.hpp"
+#include <iostream>
+#include <cassert>
+#include <map>
+#include <string>
+
+typedef sjtu::multimap<int, std::string> names;
+
+unsigned int seed = 81;
+
+int next_rand() {
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % 1000;
+}
+
+//	std::multimap keeps equal keys in insertion order as well
+void check(names &map, const std::multimap<int, std::string> &ref) {
+	assert(map.size() == ref.size());
+	auto it = map.begin();
+	for (auto &p : ref) {
+		assert(it.key() == p.first && it.value() == p.second);
+		++it;
+	}
+	assert(it == map.end());
+	for (auto r = ref.rbegin(); r != ref.rend(); ++r) {
+		--it;
+		assert(it.key() == r->first && it.value() == r->second);
+	}
+	assert(it == map.begin());
+}
+
+//	one hot key growing through several chunks, then emptied from the middle
+void test_long_run() {
+	names map;
+	std::multimap<int, std::string> ref;
+	for (int i = 0; i < 3000; ++i) {
+		std::string value = std::to_string(i);
+		auto it = map.insert(sjtu::pair<const int, std::string>(i % 3 == 0 ? 1 : 7, value));
+		assert(it.value() == value);
+		ref.insert(std::make_pair(i % 3 == 0 ? 1 : 7, value));
+	}
+	check(map, ref);
+	std::cout << map.count(1) << " " << map.count(7) << " " << map.key_count() << std::endl;
+	//	erase every third value of key 7 by position
+	for (int round = 0; map.count(7) > 1000; ++round) {
+		auto range = map.equal_range(7);
+		auto r = ref.equal_range(7);
+		int skip = round % 5;
+		for (int i = 0; i < skip; ++i) ++range.first, ++r.first;
+		map.erase(range.first);
+		ref.erase(r.first);
+	}
+	check(map, ref);
+	std::cout << map.count(7) << " " << map.find(7).value() << std::endl;
+}
+
+void test_random() {
+	names map;
+	std::multimap<int, std::string> ref;
+	for (int step = 0; step < 100000; ++step) {
+		int key = next_rand() % 300, op = next_rand() % 6;
+		if (op < 3) {
+			std::string value(next_rand() % 20, char('a' + step % 26));
+			map.insert(sjtu::pair<const int, std::string>(key, value));
+			ref.insert(std::make_pair(key, value));
+		} else if (op == 3) {
+			if (next_rand() % 4 == 0) assert(map.erase(key) == ref.erase(key));
+			else if (ref.count(key)) {
+				int which = next_rand() % ref.count(key);
+				auto it = map.find(key);
+				auto r = ref.find(key);
+				for (int i = 0; i < which; ++i) ++it, ++r;
+				assert(it.value() == r->second);
+				map.erase(it);
+				ref.erase(r);
+			}
+		} else if (op == 4) {
+			assert(map.count(key) == ref.count(key));
+			auto range = map.equal_range(key);
+			auto r = ref.equal_range(key);
+			for (; r.first != r.second; ++r.first, ++range.first) assert(range.first.value() == r.first->second);
+			assert(range.first == range.second);
+		} else {
+			assert((map.find(key) == map.end()) == (ref.find(key) == ref.end()));
+		}
+	}
+	check(map, ref);
+	names copy(map);
+	map.clear();
+	check(copy, ref);
+	map = copy;
+	check(map, ref);
+	try {
+		map.erase(map.end());
+		assert(false);
+	} catch (sjtu::invalid_iterator &) {}
+	std::cout << map.size() << " " << map.key_count() << " " << copy.size() << std::endl;
+}
+
+int main() {
+	test_long_run();
+	test_random();
+	return 0;
+}
@@ -0,0 +1,95 @@
+#include "mvcc_map.hpp"
+#include <iostream>
+#include <cassert>
+#include <map>
+
+typedef sjtu::mvcc_map<int, int> mvcc;
+typedef mvcc::read_view view;
+
+unsigned int seed = 77;
+
+int next_rand() {
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % 1000;
+}
+
+struct collector {
+	std::map<int, int> *out;
+	void operator () (const int &key, const int &value) {
+		(*out)[key] = value;
+	}
+};
+
+std::map<int, int> contents(const view &v) {
+	std::map<int, int> res;
+	v.for_each(collector{&res});
+	return res;
+}
+
+//	a copied view keeps the original's versions after the original is gone
+void test_view_copy() {
+	mvcc map;
+	map.put(1, -1);
+	view *first = new view(map.snapshot());
+	map.put(1, 100);
+	view *later = new view(map.snapshot());
+	view *copy = new view(*first);
+	delete first;
+	for (int i = 0; i < 1000; ++i) map.put(1000 + i, i);
+	map.gc();
+	std::cout << *copy->find(1) << " " << *later->find(1) << " " << copy->timestamp() << std::endl;
+	delete later;
+	map.gc();
+	std::cout << *copy->find(1) << " " << copy->count(1000) << std::endl;
+	delete copy;
+	map.gc();
+	std::cout << *map.find(1) << " " << map.size() << " " << map.version_count() << std::endl;
+}
+
+//	snapshots against std::map copies taken at the same time
+void test_snapshots() {
+	mvcc map;
+	std::map<int, int> ref;
+	view *views[8];
+	std::map<int, int> seen[8];
+	int view_n = 0;
+	for (int step = 0; step < 20000; ++step) {
+		int key = next_rand(), op = next_rand() % 10;
+		if (op < 6) {
+			map.put(key, step);
+			ref[key] = step;
+		} else if (op < 9) {
+			assert(map.erase(key) == (ref.erase(key) == 1));
+		} else if (view_n < 8) {
+			views[view_n] = new view(map.snapshot());
+			seen[view_n++] = ref;
+		} else {
+			//	replace a random view by a copy of another one
+			int drop = next_rand() % 8, from = next_rand() % 8;
+			if (drop != from) {
+				view *copy = new view(*views[from]);
+				delete views[drop];
+				views[drop] = copy;
+				seen[drop] = seen[from];
+			}
+		}
+		if (step % 1000 == 999) {
+			for (int i = 0; i < view_n; ++i) assert(contents(*views[i]) == seen[i]);
+			map.gc();
+		}
+	}
+	assert(map.size() == ref.size());
+	for (int i = 0; i < view_n; ++i) {
+		assert(contents(*views[i]) == seen[i]);
+		delete views[i];
+	}
+	size_t pinned = map.version_count();
+	map.gc();
+	std::cout << (map.version_count() < pinned) << " " << (map.version_count() == ref.size()) << std::endl;
+}
+
+int main() {
+	test_view_copy();
+	test_snapshots();
+	return 0;
+}
@@ -0,0 +1,132 @@
+#include "map.hpp"
+#include <iostream>
+#include <cassert>
+#include <map>
+#include <vector>
+
+typedef sjtu::map<int, int> int_map;
+
+unsigned int seed = 83;
+
+int next_rand() {
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % 20000;
+}
+
+struct is_odd {
+	bool operator()(const int_map::value_type &v) const { return v.second % 2 != 0; }
+};
+
+//	the cached extremes agree with the tree and the reference
+void check_ends(int_map &map, const std::map<int, int> &ref) {
+	assert(map.size() == ref.size());
+	if (ref.empty()) {
+		assert(map.begin() == map.end());
+		try {
+			map.peek_min();
+			assert(false);
+		} catch (sjtu::container_is_empty &) {}
+		return;
+	}
+	assert(map.peek_min().first == ref.begin()->first && map.peek_min().second == ref.begin()->second);
+	assert(map.peek_max().first == ref.rbegin()->first && map.peek_max().second == ref.rbegin()->second);
+	assert(map.begin()->first == ref.begin()->first);
+	auto last = map.end();
+	--last;
+	assert(last->first == ref.rbegin()->first);
+}
+
+//	double-ended priority queue use: pushes and pops from both ends
+void test_queue() {
+	int_map map;
+	std::map<int, int> ref;
+	long long popped = 0;
+	for (int step = 0; step < 300000; ++step) {
+		int key = next_rand(), op = next_rand() % 8;
+		if (op < 4) {
+			map[key] = step;
+			ref[key] = step;
+		} else if (op == 4 && !ref.empty()) {
+			popped += map.peek_min().first;
+			map.pop_min();
+			ref.erase(ref.begin());
+		} else if (op == 5 && !ref.empty()) {
+			popped += map.peek_max().first;
+			map.pop_max();
+			ref.erase(--ref.end());
+		} else if (op == 6) {
+			auto it = map.find(key);
+			if (it != map.end()) map.erase(it);
+			ref.erase(key);
+		} else if (!ref.empty()) {
+			map.peek_max().second = -step; // writable in place
+			ref.rbegin()->second = -step;
+		}
+		check_ends(map, ref);
+	}
+	while (!ref.empty()) {
+		popped += map.peek_min().first;
+		map.pop_min();
+		ref.erase(ref.begin());
+	}
+	check_ends(map, ref);
+	try {
+		map.pop_max();
+		assert(false);
+	} catch (sjtu::container_is_empty &) {}
+	std::cout << popped << std::endl;
+}
+
+//	every way the tree is rebuilt or relinked keeps the extremes
+void test_rebuilds() {
+	int_map map;
+	std::map<int, int> ref;
+	for (int i = 0; i < 5000; ++i) {
+		int key = next_rand();
+		map[key] = i;
+		ref[key] = i;
+	}
+	check_ends(map, ref);
+	//	a batch that erases both ends and adds new ones
+	std::vector<int_map::value_type> fresh;
+	fresh.push_back(int_map::value_type(-5, 1));
+	fresh.push_back(int_map::value_type(50000, 2));
+	int lo = ref.begin()->first, hi = ref.rbegin()->first;
+	int_map::batch_op ops[] = {int_map::batch_op::erase(lo), int_map::batch_op::erase(hi),
+	                           int_map::batch_op::insert(fresh[0]), int_map::batch_op::insert(fresh[1])};
+	map.apply_batch(ops, 4);
+	ref.erase(lo);
+	ref.erase(hi);
+	ref[-5] = 1;
+	ref[50000] = 2;
+	check_ends(map, ref);
+	map.remove_if(is_odd());
+	for (auto it = ref.begin(); it != ref.end();) {
+		if (it->second % 2 != 0) it = ref.erase(it);
+		else ++it;
+	}
+	check_ends(map, ref);
+	int_map upper;
+	map.split(10000, upper);
+	std::map<int, int> ref_upper(ref.lower_bound(10000), ref.end());
+	ref.erase(ref.lower_bound(10000), ref.end());
+	check_ends(map, ref);
+	check_ends(upper, ref_upper);
+	int_map copy(upper);
+	check_ends(copy, ref_upper);
+	map.join(upper);
+	ref.insert(ref_upper.begin(), ref_upper.end());
+	check_ends(map, ref);
+	check_ends(upper, std::map<int, int>());
+	upper = map;
+	check_ends(upper, ref);
+	map.clear();
+	check_ends(map, std::map<int, int>());
+	std::cout << upper.size() << " " << upper.peek_min().first << " " << upper.peek_max().first << std::endl;
+}
+
+int main() {
+	test_queue();
+	test_rebuilds();
+	return 0;
+}
@@ -0,0 +1,132 @@
+#include "map.hpp"
+#include <iostream>
+#include <cassert>
+#include <map>
+#include <string>
+
+//	counts live copies; copying throws once armed reaches zero
+class Tracked {
+public:
+	static int alive;
+	static int armed;
+	std::string val;
+
+	Tracked(const std::string &v) : val(v) { ++alive; }
+	Tracked(const Tracked &rhs) : val(rhs.val) {
+		if (armed > 0 && --armed == 0) throw std::string("copy failed");
+		++alive;
+	}
+	Tracked &operator=(const Tracked &rhs) {
+		val = rhs.val;
+		return *this;
+	}
+	~Tracked() { --alive; }
+};
+
+int Tracked::alive = 0;
+int Tracked::armed = 0;
+
+typedef sjtu::map<int, Tracked> tracked_map;
+
+unsigned int seed = 90;
+
+int next_rand() {
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % 10000;
+}
+
+void check(const tracked_map &map, const std::map<int, std::string> &ref) {
+	assert(map.size() == ref.size());
+	auto it = map.cbegin();
+	for (auto &p : ref) {
+		assert(it->first == p.first && it->second.val == p.second);
+		++it;
+	}
+	assert(it == map.cend());
+}
+
+void test_capacity() {
+	tracked_map map;
+	std::map<int, std::string> ref;
+	map.reserve(1000);
+	std::cout << map.capacity() << " ";
+	for (int i = 0; i < 1500; ++i) {
+		int key = next_rand();
+		map.insert(tracked_map::value_type(key, Tracked(std::to_string(i))));
+		ref.insert(std::make_pair(key, std::to_string(i)));
+	}
+	check(map, ref);
+	//	erased slots go back to the reserved list
+	size_t before = map.capacity();
+	for (int i = 0; i < 3000; ++i) {
+		auto it = map.find(next_rand());
+		if (it == map.end()) continue;
+		ref.erase(it->first);
+		map.erase(it);
+	}
+	check(map, ref);
+	std::cout << (before >= 1000) << " " << (map.capacity() >= map.size()) << " ";
+	//	reserve again on top, then a copy: the copy does not share blocks
+	map.reserve(map.size() + 500);
+	tracked_map copy(map);
+	check(copy, ref);
+	map.shrink_to_fit();
+	check(map, ref);
+	std::cout << (map.capacity() == map.size()) << " ";
+	//	shrink_to_fit failing halfway leaves everything as it was
+	map.reserve(map.size() + 100);
+	size_t cap = map.capacity();
+	Tracked::armed = (int)map.size() / 2;
+	try {
+		map.shrink_to_fit();
+		assert(false);
+	} catch (std::string &) {}
+	Tracked::armed = 0;
+	check(map, ref);
+	std::cout << (map.capacity() == cap) << " ";
+	//	clear keeps what was reserved; split refuses a map holding it,
+	//	while the copy, which reserved nothing, splits
+	map.clear();
+	std::cout << map.size() << " " << (map.capacity() == cap) << " ";
+	tracked_map upper;
+	try {
+		map.split(5000, upper);
+		assert(false);
+	} catch (sjtu::runtime_error &) {}
+	copy.split(5000, upper);
+	std::cout << (copy.size() + upper.size() == ref.size()) << " ";
+	map.shrink_to_fit();
+	std::cout << map.capacity() << std::endl;
+}
+
+void test_random() {
+	tracked_map map;
+	std::map<int, std::string> ref;
+	for (int step = 0; step < 50000; ++step) {
+		int key = next_rand(), op = next_rand() % 10;
+		if (op < 4) {
+			map.insert(tracked_map::value_type(key, Tracked("v" + std::to_string(step))));
+			ref.insert(std::make_pair(key, "v" + std::to_string(step)));
+		} else if (op < 7) {
+			auto it = map.find(key);
+			if (it != map.end()) map.erase(it);
+			ref.erase(key);
+		} else if (op == 7) {
+			map.reserve(map.size() + next_rand() % 300);
+		} else if (op == 8 && step % 20 == 0) {
+			map.shrink_to_fit();
+		} else {
+			assert(map.count(key) == ref.count(key));
+		}
+		assert(map.capacity() >= map.size());
+	}
+	check(map, ref);
+	std::cout << map.size() << std::endl;
+}
+
+int main() {
+	test_capacity();
+	test_random();
+	std::cout << Tracked::alive << std::endl;
+	return 0;
+}
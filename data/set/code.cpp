@@ -0,0 +1,99 @@
+#include "set.hpp"
+#include <iostream>
+#include <cassert>
+#include <set>
+#include <string>
+
+unsigned int seed = 82;
+
+int next_rand() {
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % 5000;
+}
+
+template<class Mine, class Ref>
+void check(const Mine &set, const Ref &ref) {
+	assert(set.size() == ref.size());
+	auto it = set.begin();
+	for (auto &k : ref) {
+		assert(*it == k);
+		++it;
+	}
+	assert(it == set.end());
+	for (auto r = ref.rbegin(); r != ref.rend(); ++r) assert(*--it == *r);
+}
+
+void test_set() {
+	sjtu::set<int> set;
+	std::set<int> ref;
+	for (int step = 0; step < 200000; ++step) {
+		int key = next_rand(), op = next_rand() % 4;
+		if (op < 2) {
+			auto res = set.insert(key);
+			assert(res.second == ref.insert(key).second && *res.first == key);
+		} else if (op == 2) {
+			if (next_rand() % 2) assert(set.erase(key) == ref.erase(key));
+			else if (set.count(key)) {
+				set.erase(set.find(key));
+				ref.erase(key);
+			}
+		} else {
+			assert(set.count(key) == ref.count(key));
+			assert((set.find(key) == set.end()) == !ref.count(key));
+		}
+	}
+	check(set, ref);
+	sjtu::set<int> copy(set);
+	set.clear();
+	check(copy, ref);
+	set = copy;
+	check(set, ref);
+	try {
+		set.erase(set.end());
+		assert(false);
+	} catch (sjtu::invalid_iterator &) {}
+	std::cout << set.size() << " " << *set.begin() << " " << *--set.end() << std::endl;
+}
+
+void test_multiset() {
+	sjtu::multiset<std::string> set;
+	std::multiset<std::string> ref;
+	for (int step = 0; step < 100000; ++step) {
+		std::string key = std::to_string(next_rand() % 700);
+		int op = next_rand() % 5;
+		if (op < 2) {
+			auto it = set.insert(key);
+			assert(*it == key);
+			ref.insert(key);
+		} else if (op == 2) {
+			if (next_rand() % 3 == 0) assert(set.erase(key) == ref.erase(key));
+			else if (ref.count(key)) {
+				set.erase(set.find(key));
+				ref.erase(ref.find(key));
+			}
+		} else if (op == 3) {
+			assert(set.count(key) == ref.count(key));
+		} else {
+			auto range = set.equal_range(key);
+			size_t n = 0;
+			for (; range.first != range.second; ++range.first, ++n) assert(*range.first == key);
+			assert(n == ref.count(key));
+		}
+	}
+	check(set, ref);
+	size_t distinct = 0;
+	for (auto it = ref.begin(); it != ref.end(); it = ref.upper_bound(*it)) ++distinct;
+	assert(set.distinct_count() == distinct);
+	sjtu::multiset<std::string> copy(set);
+	set.clear();
+	check(copy, ref);
+	set = copy;
+	check(set, ref);
+	std::cout << set.size() << " " << set.distinct_count() << " " << *set.begin() << std::endl;
+}
+
+int main() {
+	test_set();
+	test_multiset();
+	return 0;
+}
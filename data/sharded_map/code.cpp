@@ -0,0 +1,142 @@
+#include "sharded_map.hpp"
+#include <iostream>
+#include <cassert>
+#include <map>
+
+unsigned int seed = 20261018;
+
+int next_rand() {
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % 1000000;
+}
+
+struct walk_stats {
+	bool started = false;
+	int prev = 0;
+	long long sum = 0;
+	size_t count = 0;
+	bool ordered = true;
+};
+
+// for_each takes its functor by value, so the results live outside
+struct checker {
+	walk_stats *stats;
+	void operator () (const sjtu::pair<const int, int> &p) {
+		if (stats->started && !(stats->prev < p.first)) stats->ordered = false;
+		stats->started = true;
+		stats->prev = p.first;
+		stats->sum += p.second;
+		++stats->count;
+	}
+};
+
+// map::split and map::join on their own, against std::map
+void test_split_join() {
+	sjtu::map<int, int> lower, upper;
+	std::map<int, int> ref;
+	for (int i = 0; i < 20000; ++i) {
+		int key = next_rand();
+		lower[key] = i;
+		ref[key] = i;
+	}
+	for (int round = 0; round < 50; ++round) {
+		int key = next_rand();
+		lower.split(key, upper);
+		size_t below = 0;
+		for (auto it = ref.begin(); it != ref.end() && it->first < key; ++it) ++below;
+		assert(lower.size() == below && upper.size() == ref.size() - below);
+		assert(lower.empty() || (--lower.end())->first < key);
+		assert(upper.empty() || upper.begin()->first >= key);
+		//	the halves stay usable on their own
+		int low_key = -1 - round, high_key = 2000000 + round;
+		lower[low_key] = round;
+		upper[high_key] = round;
+		ref[low_key] = round;
+		ref[high_key] = round;
+		lower.join(upper);
+		assert(upper.empty() && lower.size() == ref.size());
+	}
+	auto it = lower.begin();
+	for (auto &p : ref) {
+		assert(it->first == p.first && it->second == p.second);
+		++it;
+	}
+	assert(it == lower.end());
+	//	a key past the end moves nothing; one before the start moves everything
+	lower.split(3000000, upper);
+	std::cout << lower.size() << " " << upper.size() << std::endl;
+	lower.split(-1000, upper);
+	std::cout << lower.size() << " " << upper.size() << std::endl;
+	lower.join(upper);
+	//	join refuses overlapping ranges and leaves both maps alone
+	upper[0] = 0;
+	try {
+		lower.join(upper);
+		assert(false);
+	} catch (sjtu::runtime_error &) {}
+	std::cout << lower.size() << " " << upper.size() << std::endl;
+}
+
+void test_sharded() {
+	sjtu::sharded_map<int, int>::policy pol;
+	pol.max_shard_size = 1000;
+	pol.hot_ops = 4000;
+	pol.cold_ops = 100;
+	pol.epoch_ops = 20000;
+	sjtu::sharded_map<int, int> map(pol);
+	std::map<int, int> ref;
+	//	test: routing while shards split
+	for (int i = 0; i < 30000; ++i) {
+		int key = next_rand();
+		bool inserted = map.insert(sjtu::pair<const int, int>(key, i));
+		assert(inserted == ref.insert(std::make_pair(key, i)).second);
+	}
+	assert(map.size() == ref.size());
+	std::cout << (map.shard_count() >= ref.size() / 1000) << std::endl;
+	for (auto &p : ref) assert(map.at(p.first) == p.second);
+	for (int i = 0; i < 10000; ++i) {
+		int key = next_rand();
+		assert(map.count(key) == ref.count(key));
+	}
+	walk_stats c;
+	map.for_each(checker{&c});
+	long long ref_sum = 0;
+	for (auto &p : ref) ref_sum += p.second;
+	std::cout << c.ordered << " " << (c.count == ref.size()) << " " << (c.sum == ref_sum) << std::endl;
+	//	test: hot shard split
+	size_t before = map.shard_count();
+	for (int i = 0; i < 5000; ++i) map.find(ref.begin()->first);
+	map.rebalance();
+	std::cout << (map.shard_count() > before) << std::endl;
+	//	test: merge after draining most keys
+	int kept = 0;
+	for (auto it = ref.begin(); it != ref.end();) {
+		if (kept++ % 50 == 0) {
+			++it;
+			continue;
+		}
+		assert(map.erase(it->first));
+		it = ref.erase(it);
+	}
+	assert(!map.erase(-1));
+	map.rebalance();
+	map.rebalance();
+	assert(map.size() == ref.size());
+	std::cout << map.size() << " " << map.shard_count() << std::endl;
+	for (auto &p : ref) assert(map.at(p.first) == p.second);
+	try {
+		map.at(-1);
+		assert(false);
+	} catch (sjtu::index_out_of_bound &) {}
+	walk_stats d;
+	map.for_each(checker{&d});
+	std::cout << d.ordered << " " << d.count << std::endl;
+	map.clear();
+	std::cout << map.size() << " " << map.shard_count() << std::endl;
+}
+
+int main() {
+	test_split_join();
+	test_sharded();
+	return 0;
+}
@@ -0,0 +1,99 @@
+#include "map.hpp"
+#include <iostream>
+#include <cassert>
+#include <cstdio>
+#include <map>
+
+struct record {
+	int id;
+	double weight;
+	char tag[4];
+};
+
+unsigned int seed = 87;
+
+int next_rand() {
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % 1000000;
+}
+
+const char *path = "snapshot.bin";
+
+void test_round_trip() {
+	sjtu::map<int, record> map;
+	std::map<int, int> ref;
+	for (int i = 0; i < 50000; ++i) {
+		int key = next_rand();
+		record r = {i, i * 0.5, {'s', 'j', 't', 'u'}};
+		map[key] = r;
+		ref[key] = i;
+	}
+	std::FILE *out = std::fopen(path, "wb");
+	map.write_snapshot(out);
+	std::fclose(out);
+	sjtu::map<int, record> loaded;
+	loaded[-1] = record();
+	std::FILE *in = std::fopen(path, "rb");
+	loaded.read_snapshot(in);
+	std::fclose(in);
+	assert(loaded.size() == ref.size());
+	auto it = loaded.cbegin();
+	for (auto &p : ref) {
+		assert(it->first == p.first && it->second.id == p.second && it->second.weight == p.second * 0.5);
+		assert(it->second.tag[3] == 'u');
+		++it;
+	}
+	//	the loaded map is an ordinary map afterwards
+	for (auto &p : ref) {
+		if (p.second % 2) {
+			auto pos = loaded.find(p.first);
+			loaded.erase(pos);
+		}
+	}
+	loaded[-5].id = 5;
+	size_t odd = 0;
+	for (auto &p : ref) odd += p.second % 2;
+	std::cout << loaded.size() << " " << (loaded.size() == ref.size() - odd + 1) << std::endl;
+	//	a copy takes the raw-payload path
+	sjtu::map<int, record> copy(loaded);
+	std::cout << copy.size() << " " << copy.at(-5).id << " " << copy.cbegin()->first << std::endl;
+}
+
+void test_bad_input() {
+	sjtu::map<int, int> map;
+	for (int i = 0; i < 10; ++i) map[i] = i;
+	std::FILE *out = std::fopen(path, "wb");
+	size_t header[3] = {sjtu::map<int, int>::snapshot_magic, sizeof(sjtu::pair<const int, int>), 3};
+	std::fwrite(header, sizeof(header), 1, out);
+	int records[6] = {1, 10, 3, 30, 2, 20};
+	std::fwrite(records, sizeof(records), 1, out);
+	std::fclose(out);
+	std::FILE *in = std::fopen(path, "rb");
+	try {
+		map.read_snapshot(in);
+		assert(false);
+	} catch (sjtu::runtime_error &) {
+		std::cout << "unsorted rejected " << map.size() << " " << map.at(9) << std::endl;
+	}
+	std::fclose(in);
+	out = std::fopen(path, "wb");
+	header[2] = 5;
+	std::fwrite(header, sizeof(header), 1, out);
+	std::fwrite(records, sizeof(int), 4, out);
+	std::fclose(out);
+	in = std::fopen(path, "rb");
+	try {
+		map.read_snapshot(in);
+		assert(false);
+	} catch (sjtu::runtime_error &) {
+		std::cout << "short rejected " << map.size() << std::endl;
+	}
+	std::fclose(in);
+	std::remove(path);
+}
+
+int main() {
+	test_round_trip();
+	test_bad_input();
+	return 0;
+}
@@ -0,0 +1,70 @@
+#include "static_map.hpp"
+#include <iostream>
+#include <cassert>
+#include <map>
+
+typedef sjtu::static_map<int, char, 6> letters;
+
+//	built and looked up at compile time
+constexpr letters table({{30, 'c'}, {10, 'a'}, {60, 'f'}, {20, 'b'}, {50, 'e'}, {40, 'd'}});
+static_assert(table.at(40) == 'd', "lookup in a constant expression");
+static_assert(table.count(45) == 0 && table.count(10) == 1, "count in a constant expression");
+static_assert(table.begin()->first == 10 && (table.end() - 1)->first == 60, "sorted at compile time");
+
+constexpr sjtu::static_map<int, int, 4, std::greater<int>> reversed({{1, 1}, {4, 16}, {2, 4}, {3, 9}});
+static_assert(reversed.begin()->first == 4 && reversed.at(3) == 9, "custom order");
+
+constexpr sjtu::static_map<int, int, 0>::value_type nothing[1] = {};
+constexpr sjtu::static_map<int, int, 0> none(nothing);
+static_assert(none.empty() && none.find(1) == none.end(), "empty table");
+
+//	a bigger table checked at run time against std::map
+void test_runtime() {
+	const size_t n = 500;
+	sjtu::static_map<int, int, n>::value_type init[n];
+	std::map<int, int> ref;
+	unsigned int seed = 86;
+	for (size_t i = 0; i < n; ++i) {
+		int key;
+		do {
+			seed = seed * 1103515245u + 12345u;
+			key = (seed >> 8) % 100000;
+		} while (ref.count(key));
+		init[i].first = key;
+		init[i].second = (int)i;
+		ref[key] = (int)i;
+	}
+	sjtu::static_map<int, int, n> map(init);
+	auto it = map.begin();
+	for (auto &p : ref) {
+		assert(it->first == p.first && it->second == p.second);
+		++it;
+	}
+	assert(it == map.end());
+	int misses = 0;
+	for (int key = -5; key < 100005; ++key) {
+		assert(map.count(key) == ref.count(key));
+		if (!ref.count(key)) {
+			++misses;
+			try {
+				map.at(key);
+				assert(false);
+			} catch (sjtu::index_out_of_bound &) {}
+		} else assert(map.at(key) == ref[key] && map.find(key)->second == ref[key]);
+	}
+	std::cout << map.size() << " " << misses << " " << map.begin()->first << std::endl;
+	//	duplicates are rejected when built at run time too
+	init[n - 1].first = init[0].first;
+	try {
+		sjtu::static_map<int, int, n> bad(init);
+		assert(false);
+	} catch (sjtu::runtime_error &) {
+		std::cout << "duplicate rejected" << std::endl;
+	}
+}
+
+int main() {
+	std::cout << table.at(10) << table.at(20) << table.at(60) << " " << reversed.at(4) << " " << none.size() << std::endl;
+	test_runtime();
+	return 0;
+}
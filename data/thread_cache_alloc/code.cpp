@@ -0,0 +1,80 @@
+#include "map.hpp"
+#include "thread_cache_alloc.hpp"
+#include <iostream>
+#include <cassert>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef sjtu::map<int, int, std::less<int>, sjtu::thread_cache_alloc> small_map;
+typedef sjtu::map<int, std::string, std::less<int>, sjtu::thread_cache_alloc> string_map;
+
+long long checksum(const small_map &map) {
+	long long sum = 0;
+	for (auto it = map.cbegin(); it != map.cend(); ++it) sum = (sum * 31 + it->first * 7 + it->second) % 1000003;
+	return sum;
+}
+
+//	many short-lived maps per thread, nodes reused through the cache
+void churn(int id, long long *out) {
+	long long total = 0;
+	for (int round = 0; round < 2000; ++round) {
+		small_map map;
+		for (int i = 0; i < 50; ++i) map[(i * 37 + round) % 101] = i + id;
+		string_map names;
+		for (int i = 0; i < 10; ++i) names[i] = std::string(i * 10, 'a' + i);
+		total += checksum(map) + names.size() + names.at(9).size();
+	}
+	*out = total;
+}
+
+//	maps built on one thread and destroyed on another
+void handoff() {
+	const int count = 64;
+	std::vector<small_map *> maps(count);
+	std::thread builder([&] {
+		for (int m = 0; m < count; ++m) {
+			maps[m] = new small_map;
+			for (int i = 0; i < 500; ++i) (*maps[m])[i] = m;
+		}
+	});
+	builder.join();
+	//	the builder has exited; its cache is parked, not freed
+	long long sum = 0;
+	std::vector<std::thread> killers;
+	for (int t = 0; t < 4; ++t) {
+		killers.emplace_back([&, t] {
+			for (int m = t; m < count; m += 4) {
+				small_map *map = maps[m];
+				//	split and join move nodes between maps on another thread
+				small_map upper;
+				map->split(250, upper);
+				map->join(upper);
+				assert(map->size() == 500 && map->at(499) == m);
+				delete map;
+			}
+		});
+	}
+	for (auto &k : killers) k.join();
+	for (int m = 0; m < count; ++m) sum += m * 500;
+	//	a new thread adopts a parked cache and reuses the returned blocks
+	std::thread reuser([&] {
+		small_map map;
+		for (int i = 0; i < 20000; ++i) map[i] = i;
+		sum += map.size();
+	});
+	reuser.join();
+	std::cout << sum << std::endl;
+}
+
+int main() {
+	const int threads = 8;
+	std::vector<long long> results(threads);
+	std::vector<std::thread> pool;
+	for (int t = 0; t < threads; ++t) pool.emplace_back(churn, t, &results[t]);
+	for (auto &t : pool) t.join();
+	for (int t = 0; t < threads; ++t) std::cout << results[t] << " ";
+	std::cout << std::endl;
+	handoff();
+	return 0;
+}
@@ -0,0 +1,111 @@
+#include "timeseries_map.hpp"
+#include <iostream>
+#include <cassert>
+#include <iterator>
+#include <map>
+#include <string>
+
+typedef sjtu::timeseries_map<long long, std::string, 16> series;
+
+unsigned int seed = 98;
+
+int next_rand() {
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % 100000;
+}
+
+void check(series &map, const std::map<long long, std::string> &ref) {
+	assert(map.size() == ref.size());
+	auto it = map.begin();
+	for (auto &p : ref) {
+		assert(it.key() == p.first && it.value() == p.second);
+		++it;
+	}
+	assert(it == map.end());
+	for (auto r = ref.rbegin(); r != ref.rend(); ++r) {
+		--it;
+		assert(it.key() == r->first);
+	}
+}
+
+//	a retention window: mostly appends, a few late samples, the front dropped
+void test_window() {
+	series map;
+	std::map<long long, std::string> ref;
+	long long now = 0;
+	size_t dropped = 0;
+	for (int step = 0; step < 100000; ++step) {
+		now += 1 + next_rand() % 5;
+		long long key = next_rand() % 20 ? now : now - next_rand() % 400; // late arrival
+		std::string value = std::to_string(step);
+		bool inserted = map.insert(key, value).second;
+		assert(inserted == ref.insert(std::make_pair(key, value)).second);
+		if (step % 100 == 99) {
+			long long t = now - 2000;
+			size_t expect = std::distance(ref.begin(), ref.lower_bound(t));
+			ref.erase(ref.begin(), ref.lower_bound(t));
+			assert(map.drop_before(t) == expect);
+			dropped += expect;
+		}
+	}
+	check(map, ref);
+	std::cout << map.size() << " " << dropped << " " << (map.chunks() * 16 >= map.size()) << std::endl;
+}
+
+void test_random() {
+	series map;
+	std::map<long long, std::string> ref;
+	for (int step = 0; step < 100000; ++step) {
+		long long key = next_rand() % 5000;
+		int op = next_rand() % 6;
+		if (op < 2) {
+			auto res = map.insert(key, "x" + std::to_string(step));
+			assert(res.second == ref.insert(std::make_pair(key, "x" + std::to_string(step))).second);
+			assert(res.first.key() == key && res.first.value() == ref[key]);
+		} else if (op == 2) {
+			assert(map.erase(key) == (ref.erase(key) == 1));
+		} else if (op == 3) {
+			auto it = map.lower_bound(key);
+			auto r = ref.lower_bound(key);
+			if (r == ref.end()) assert(it == map.end());
+			else {
+				assert(it.key() == r->first);
+				if (step % 2) {
+					map.erase(it);
+					ref.erase(r);
+				}
+			}
+		} else if (op == 4) {
+			assert(map.count(key) == ref.count(key));
+			if (ref.count(key)) assert(map.at(key) == ref[key] && map.find(key).value() == ref[key]);
+			else {
+				assert(map.find(key) == map.end());
+				try {
+					map.at(key);
+					assert(false);
+				} catch (sjtu::index_out_of_bound &) {}
+			}
+		} else if (step % 500 == 0) {
+			long long t = next_rand() % 300;
+			ref.erase(ref.begin(), ref.lower_bound(t));
+			map.drop_before(t);
+		}
+	}
+	check(map, ref);
+	series copy(map);
+	map.clear();
+	check(copy, ref);
+	map = copy;
+	check(map, ref);
+	try {
+		map.erase(map.end());
+		assert(false);
+	} catch (sjtu::invalid_iterator &) {}
+	std::cout << map.size() << " " << map.begin().key() << std::endl;
+}
+
+int main() {
+	test_window();
+	test_random();
+	return 0;
+}
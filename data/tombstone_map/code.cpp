@@ -0,0 +1,121 @@
+#include "tombstone_map.hpp"
+#include <iostream>
+#include <cassert>
+#include <map>
+
+unsigned int seed = 92;
+
+int next_rand() {
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) % 5000;
+}
+
+void check(sjtu::tombstone_map<int, int> &map, const std::map<int, int> &ref) {
+	assert(map.size() == ref.size());
+	auto it = map.begin();
+	for (auto &p : ref) {
+		assert(it.key() == p.first && it.value() == p.second);
+		++it;
+	}
+	assert(it == map.end());
+}
+
+//	erasing every other element while walking, far past the threshold
+void test_erase_while_iterating() {
+	sjtu::tombstone_map<int, int> map(10);
+	std::map<int, int> ref;
+	for (int i = 0; i < 10000; ++i) {
+		map[i] = i;
+		ref[i] = i;
+	}
+	int visited = 0;
+	for (auto it = map.begin(); it != map.end(); ++visited) {
+		if (it.key() % 2 == 0) {
+			ref.erase(it.key());
+			it = map.erase(it);
+		} else ++it;
+	}
+	//	the walk itself purged along the way, leaving at most 10% tombstones
+	assert(map.tombstones() * 100 <= (map.size() + map.tombstones()) * 10 + 100);
+	std::cout << visited << " " << map.size() << " " << (map.tombstones() < 5000) << std::endl;
+	check(map, ref);
+	//	purges keep iterators to live entries valid
+	auto first = map.begin();
+	for (int i = 3; i < 10000; i += 4) {
+		assert(map.erase(i));
+		ref.erase(i);
+	}
+	std::cout << first.key() << " " << first.value() << " " << map.size() << std::endl;
+	check(map, ref);
+	//	erasing the key under the cursor, then stepping on
+	for (auto it = map.begin(); it != map.end();) {
+		int key = it.key();
+		if (key % 3 == 0) {
+			assert(map.erase(key));
+			ref.erase(key);
+		}
+		++it;
+	}
+	check(map, ref);
+	map.insert(sjtu::pair<const int, int>(-1, -1));
+	ref[-1] = -1;
+	check(map, ref);
+	std::cout << map.size() << " " << map.compact() + map.size() << std::endl;
+}
+
+//	a delete-only burst frees memory without compact()
+void test_delete_burst() {
+	sjtu::tombstone_map<int, int> map(25);
+	for (int i = 0; i < 100000; ++i) map[i] = i;
+	size_t peak = 0;
+	for (int i = 0; i < 100000; ++i) {
+		if (i % 10 != 0) assert(map.erase(i));
+		if (map.tombstones() > peak) peak = map.tombstones();
+	}
+	assert(map.size() == 10000);
+	std::cout << (peak <= 25001) << " " << (map.tombstones() * 100 <= (map.size() + map.tombstones()) * 25 + 100)
+	          << std::endl;
+	int expect = 0;
+	for (auto it = map.begin(); it != map.end(); ++it, expect += 10) assert(it.key() == expect && it.value() == expect);
+	assert(expect == 100000);
+}
+
+void test_random() {
+	sjtu::tombstone_map<int, int> map;
+	std::map<int, int> ref;
+	size_t compacted = 0;
+	for (int step = 0; step < 200000; ++step) {
+		int key = next_rand(), op = next_rand() % 5;
+		if (op < 2) {
+			bool inserted = map.insert(sjtu::pair<const int, int>(key, step)).second;
+			assert(inserted == ref.insert(std::make_pair(key, step)).second);
+		} else if (op == 2) {
+			map[key] = step;
+			ref[key] = step;
+		} else if (op == 3) {
+			assert(map.erase(key) == (ref.erase(key) == 1));
+		} else {
+			assert(map.count(key) == ref.count(key));
+			if (ref.count(key)) assert(map.at(key) == ref[key] && map.find(key).value() == ref[key]);
+			else assert(map.find(key) == map.end());
+		}
+		if (step % 50000 == 49999) compacted += map.compact();
+	}
+	check(map, ref);
+	auto last = map.end();
+	--last;
+	std::cout << map.size() << " " << (compacted > 0) << " " << (last.key() == (--ref.end())->first) << std::endl;
+	try {
+		map.erase(map.end());
+		assert(false);
+	} catch (sjtu::invalid_iterator &) {}
+	map.clear();
+	std::cout << map.size() << " " << map.tombstones() << " " << (map.begin() == map.end()) << std::endl;
+}
+
+int main() {
+	test_erase_while_iterating();
+	test_delete_burst();
+	test_random();
+	return 0;
+}
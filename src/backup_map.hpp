@@ -0,0 +1,245 @@
+/**
+* locked map that can stream a consistent backup while writers go on
+*/
+#ifndef SJTU_BACKUP_MAP_HPP
+#define SJTU_BACKUP_MAP_HPP
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include "map.hpp"
+
+namespace sjtu {
+
+/**
+ * sjtu::map behind a mutex, with start_backup(path) writing the contents
+ * as of that call to a file in map::write_snapshot format (so
+ * map::read_snapshot loads it) without stopping writers for the whole
+ * dump. A background thread walks the map in key order one block at a
+ * time, holding the lock only while it gathers a block and writing the
+ * block with the lock released.
+ *
+ * Consistency is copy-on-write at key granularity: while a backup runs,
+ * the first write to a key the thread has not reached yet saves the key's
+ * preimage (its value at start, or the fact that it did not exist), and
+ * the thread emits preimages in place of the live entries. Writers only
+ * pay an extra lookup plus, once per touched key, a copy. Key and T must
+ * be trivially copyable, as for write_snapshot.
+ */
+template<
+   class Key,
+   class T,
+   class Compare = std::less<Key>
+   > class backup_map {
+  public:
+   typedef pair<const Key, T> value_type;
+   typedef map<Key, T, Compare> map_type;
+
+   // what a finished backup did to the writers
+   struct backup_report {
+     size_t records = 0;   // entries written, the size at start_backup()
+     size_t preimages = 0; // keys writers touched before the thread got there
+     size_t batches = 0;   // times the thread took the lock
+     long long total_hold_us = 0; // lock time spent gathering blocks
+     long long max_hold_us = 0;   // longest single hold: a writer's worst extra wait
+   };
+
+  private:
+   static_assert(detail::is_raw_payload<value_type>::value, "backup_map needs trivially copyable Key and T");
+
+   map_type live;
+   Compare comp;
+   mutable std::mutex lock;
+   // serialises start_backup and wait_backup, which touch worker; taken
+   // before lock, never held by the thread itself
+   std::mutex control;
+
+   // backup state, guarded by lock
+   bool active = false;
+   bool started = false; // the thread has emitted or skipped a key already
+   Key cursor;           // the last key it did, valid once started
+   map_type saved;       // preimages of keys that existed at start
+   map<Key, bool, Compare> born; // keys touched that did not exist at start
+
+   std::thread worker;
+   bool failed = false;
+   backup_report report;
+
+   // keys up to the cursor are on their way to the file already
+   bool reached(const Key &key) const { return started && !comp(cursor, key); }
+
+   // the copy-on-write hook; every writer calls it under the lock first
+   void preserve(const Key &key) {
+     if (!active || reached(key) || saved.count(key) || born.count(key)) return;
+     typename map_type::iterator it = live.find(key);
+     if (it == live.end()) born.insert(typename map<Key, bool, Compare>::value_type(key, true));
+     else saved.insert(*it);
+   }
+
+   /**
+    * fills buf with up to max records of the start-time view past the
+    * cursor: live entries, except that saved preimages win and born keys
+    * are skipped. Returns how many; sets done when both sources ran out.
+    */
+   size_t gather(unsigned char *buf, size_t max, bool &done) {
+     typename map_type::iterator x = started ? live.lower_bound(cursor) : live.begin();
+     typename map_type::iterator y = started ? saved.lower_bound(cursor) : saved.begin();
+     if (started && x != live.end() && !comp(cursor, x->first)) ++x;
+     if (started && y != saved.end() && !comp(cursor, y->first)) ++y;
+     size_t n = 0;
+     while (n < max && (x != live.end() || y != saved.end())) {
+       bool from_saved = x == live.end() || (y != saved.end() && !comp(x->first, y->first));
+       const value_type *rec = nullptr;
+       if (from_saved) {
+         if (x != live.end() && !comp(y->first, x->first)) ++x; // the live version is newer
+         rec = &*y;
+         ++y;
+       } else {
+         if (!born.count(x->first)) rec = &*x;
+         else cursor = x->first;
+         ++x;
+       }
+       if (rec) {
+         std::memcpy(buf + n * sizeof(value_type), static_cast<const void *>(rec), sizeof(value_type));
+         ++n;
+         cursor = rec->first;
+       }
+       started = true;
+     }
+     done = x == live.end() && y == saved.end();
+     return n;
+   }
+
+   void run(std::FILE *out, size_t total) {
+     typedef std::chrono::steady_clock clock;
+     const size_t per_block = map_type::snapshot_block / sizeof(value_type) ? map_type::snapshot_block / sizeof(value_type) : 1;
+     alignas(value_type) unsigned char buf[per_block * sizeof(value_type)];
+     bool ok = true;
+     size_t written = 0;
+     try {
+       size_t header[3] = {map_type::snapshot_magic, sizeof(value_type), total};
+       ok = std::fwrite(header, sizeof(header), 1, out) == 1;
+       for (bool done = false; ok && !done;) {
+         size_t n;
+         {
+           std::lock_guard<std::mutex> guard(lock);
+           clock::time_point begin = clock::now();
+           n = gather(buf, per_block, done);
+           long long us = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - begin).count();
+           ++report.batches;
+           report.total_hold_us += us;
+           if (us > report.max_hold_us) report.max_hold_us = us;
+         }
+         ok = !n || std::fwrite(buf, sizeof(value_type), n, out) == n;
+         written += n;
+       }
+     } catch (...) {
+       ok = false;
+     }
+     if (std::fclose(out) != 0) ok = false;
+     std::lock_guard<std::mutex> guard(lock);
+     report.records = written;
+     report.preimages = saved.size() + born.size();
+     failed = !ok || written != total;
+     active = false;
+     saved.clear();
+     born.clear();
+   }
+
+  public:
+   backup_map() = default;
+   backup_map(const backup_map &) = delete;
+   backup_map &operator=(const backup_map &) = delete;
+   ~backup_map() {
+     std::lock_guard<std::mutex> guard(control);
+     if (worker.joinable()) worker.join();
+   }
+
+   size_t size() const {
+     std::lock_guard<std::mutex> guard(lock);
+     return live.size();
+   }
+
+   // copies the value out, since a reference would outlive the lock
+   bool get(const Key &key, T &out) const {
+     std::lock_guard<std::mutex> guard(lock);
+     typename map_type::const_iterator it = live.find(key);
+     if (it == live.cend()) return false;
+     out = it->second;
+     return true;
+   }
+
+   // leaves an existing key untouched; returns whether it inserted
+   bool insert(const Key &key, const T &value) {
+     std::lock_guard<std::mutex> guard(lock);
+     if (live.find(key) != live.end()) return false; // nothing changes, nothing to save
+     preserve(key);
+     live.insert(value_type(key, value));
+     return true;
+   }
+
+   // inserts or overwrites
+   void assign(const Key &key, const T &value) {
+     std::lock_guard<std::mutex> guard(lock);
+     preserve(key);
+     live[key] = value;
+   }
+
+   bool erase(const Key &key) {
+     std::lock_guard<std::mutex> guard(lock);
+     typename map_type::iterator it = live.find(key);
+     if (it == live.end()) return false;
+     preserve(key);
+     live.erase(it);
+     return true;
+   }
+
+   /**
+    * starts writing the current contents to path on a background thread
+    * and returns at once. Throws runtime_error if a backup is still
+    * running (or was not collected with wait_backup()) or the file cannot
+    * be opened. Safe to call from several threads: exactly one of
+    * concurrent calls starts a backup.
+    */
+   void start_backup(const char *path) {
+     std::lock_guard<std::mutex> serial(control);
+     std::lock_guard<std::mutex> guard(lock);
+     if (active || worker.joinable()) throw runtime_error();
+     std::FILE *out = std::fopen(path, "wb");
+     if (!out) throw runtime_error();
+     active = true;
+     started = false;
+     failed = false;
+     report = backup_report();
+     size_t total = live.size();
+     try {
+       worker = std::thread(&backup_map::run, this, out, total);
+     } catch (...) {
+       active = false;
+       std::fclose(out);
+       throw;
+     }
+   }
+
+   bool backup_running() const {
+     std::lock_guard<std::mutex> guard(lock);
+     return active;
+   }
+
+   // waits for the running backup; throws runtime_error if writing failed
+   backup_report wait_backup() {
+     std::lock_guard<std::mutex> serial(control);
+     if (!worker.joinable()) throw runtime_error();
+     worker.join();
+     std::lock_guard<std::mutex> guard(lock);
+     if (failed) throw runtime_error();
+     return report;
+   }
+};
+
+}
+
+#endif
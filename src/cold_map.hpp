@@ -0,0 +1,474 @@
+/**
+* map that keeps rarely used key ranges compressed
+*/
+#ifndef SJTU_COLD_MAP_HPP
+#define SJTU_COLD_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "map.hpp"
+
+namespace sjtu {
+
+namespace detail {
+
+/**
+ * small LZ77 byte codec in the LZ4 mould: a stream of sequences, each a
+ * token (literal count in the high nibble, match length - 4 in the low
+ * one, 15 meaning "more bytes follow"), the literals, and a 2-byte match
+ * offset. The last sequence carries literals only. Single pass, one hash
+ * probe per position, no entropy stage: fast rather than tight.
+ */
+struct lz_codec {
+   static const size_t min_match = 4;
+   static const size_t max_offset = 65535;
+   static const int hash_bits = 12;
+
+   // worst case output for n input bytes
+   static size_t bound(size_t n) { return n + n / 255 + 16; }
+
+   static void put_length(unsigned char *&out, size_t len) {
+     for (; len >= 255; len -= 255) *out++ = 255;
+     *out++ = static_cast<unsigned char>(len);
+   }
+
+   static size_t get_length(const unsigned char *&in, size_t len) {
+     if (len != 15) return len;
+     unsigned char b;
+     do {
+       b = *in++;
+       len += b;
+     } while (b == 255);
+     return len;
+   }
+
+   static void put_sequence(unsigned char *&out, const unsigned char *lit, size_t lit_len,
+                            size_t offset, size_t match_len) {
+     size_t m = match_len ? match_len - min_match : 0;
+     *out++ = static_cast<unsigned char>((lit_len < 15 ? lit_len : 15) << 4 | (m < 15 ? m : 15));
+     if (lit_len >= 15) put_length(out, lit_len - 15);
+     std::memcpy(out, lit, lit_len);
+     out += lit_len;
+     if (!match_len) return;
+     *out++ = static_cast<unsigned char>(offset);
+     *out++ = static_cast<unsigned char>(offset >> 8);
+     if (m >= 15) put_length(out, m - 15);
+   }
+
+   // compresses n bytes of src into dst (bound(n) bytes); returns the size
+   static size_t pack(const unsigned char *src, size_t n, unsigned char *dst) {
+     std::uint32_t table[1 << hash_bits] = {}; // position + 1 of the last sighting
+     unsigned char *out = dst;
+     size_t anchor = 0;
+     for (size_t i = 0; i + min_match <= n;) {
+       std::uint32_t seq;
+       std::memcpy(&seq, src + i, sizeof(seq));
+       std::uint32_t h = (seq * 2654435761u) >> (32 - hash_bits);
+       size_t cand = table[h];
+       table[h] = static_cast<std::uint32_t>(i + 1);
+       if (!cand || i - (cand - 1) > max_offset || std::memcmp(src + cand - 1, src + i, min_match) != 0) {
+         ++i;
+         continue;
+       }
+       size_t from = cand - 1, len = min_match;
+       while (i + len < n && src[from + len] == src[i + len]) ++len;
+       put_sequence(out, src + anchor, i - anchor, i - from, len);
+       i += len;
+       anchor = i;
+     }
+     put_sequence(out, src + anchor, n - anchor, 0, 0);
+     return out - dst;
+   }
+
+   // inverse of pack; dst receives the original bytes
+   static void unpack(const unsigned char *src, size_t packed, unsigned char *dst) {
+     const unsigned char *in = src, *end = src + packed;
+     unsigned char *out = dst;
+     for (;;) {
+       unsigned token = *in++;
+       size_t lit = get_length(in, token >> 4);
+       std::memcpy(out, in, lit);
+       out += lit;
+       in += lit;
+       if (in >= end) return;
+       size_t offset = in[0] | size_t(in[1]) << 8;
+       in += 2;
+       size_t len = get_length(in, token & 15) + min_match;
+       // byte by byte: the match may overlap what it is copying
+       for (const unsigned char *from = out - offset; len; --len) *out++ = *from++;
+     }
+   }
+};
+
+}
+
+/**
+ * ordered map that moves key ranges nobody has touched for a while into
+ * compressed blocks. Every operation, reads included, ticks a clock and
+ * stamps the hot entry it touches; compact_cold(age) takes each run of consecutive keys left
+ * unstamped for age ticks and packs it, up to block_entries at a time,
+ * into a block: the keys delta-coded byte-wise (so slowly growing integer
+ * keys turn into runs of zero bytes), then everything through
+ * detail::lz_codec. Only the block's key range stays uncompressed.
+ *
+ * Access is transparent. get() and count() keep a hot key hot, and on a
+ * cold key decode the block into a scratch buffer and leave it cold; at(), operator[], insert() and
+ * erase() on a key inside a block's range thaw the whole block back into
+ * the hot map first, since the range is evidently warm again. No hot key
+ * ever lies inside a block's range, so a key is looked up in the hot map
+ * and in at most one block. Key and T must be trivially copyable. Not
+ * thread-safe, not even for const calls (they share the scratch buffer
+ * and stamp what they read).
+ */
+template<
+   class Key,
+   class T,
+   class Compare = std::less<Key>
+   > class cold_map {
+  public:
+   typedef pair<const Key, T> value_type;
+
+   struct memory_report {
+     size_t hot_entries = 0;
+     size_t cold_entries = 0;
+     size_t cold_blocks = 0;
+     size_t cold_raw_bytes = 0;    // what the cold entries take as plain key/value pairs
+     size_t cold_packed_bytes = 0; // what they take compressed, block headers included
+   };
+
+  private:
+   static_assert(detail::is_raw_payload<Key>::value && detail::is_raw_payload<T>::value,
+                 "cold_map needs trivially copyable Key and T");
+
+   static const size_t frozen = size_t(-1); // stamp of entries being packed
+
+   struct slot {
+     T value;
+     mutable size_t touched; // const reads stamp it too
+     slot(const T &v, size_t t) : value(v), touched(t) {}
+   };
+   typedef map<Key, slot, Compare> hot_type;
+
+   struct block {
+     Key lo, hi;
+     size_t n, packed;
+     unsigned char *bytes;
+     block(const Key &l, const Key &h, size_t count, size_t size)
+         : lo(l), hi(h), n(count), packed(size), bytes(new unsigned char[size]) {}
+     block(const block &) = delete;
+     block &operator=(const block &) = delete;
+     ~block() { delete[] bytes; }
+   };
+
+   hot_type hot;
+   block **blocks = nullptr; // sorted by range, ranges disjoint
+   size_t block_count = 0;
+   size_t cold_count = 0;
+   size_t block_entries;
+   size_t min_run;
+   mutable size_t clock = 0;
+   Compare comp;
+   mutable unsigned char *scratch = nullptr; // one decoded block
+
+   /**
+    * decoded layout of n entries: the keys, then the values from the next
+    * multiple of alignof(T); scratch comes from new[] so both are aligned
+    */
+   static size_t values_at(size_t n) { return (n * sizeof(Key) + alignof(T) - 1) / alignof(T) * alignof(T); }
+   static size_t raw_size(size_t n) { return values_at(n) + n * sizeof(T); }
+
+   unsigned char *scratch_buffer() const {
+     if (!scratch) scratch = new unsigned char[raw_size(block_entries)];
+     return scratch;
+   }
+
+   static const Key &key_in(const unsigned char *raw, size_t i) {
+     return reinterpret_cast<const Key *>(raw)[i];
+   }
+   static const T &value_in(const unsigned char *raw, size_t n, size_t i) {
+     return reinterpret_cast<const T *>(raw + values_at(n))[i];
+   }
+
+   // decodes block b into the scratch buffer
+   const unsigned char *decode(const block *b) const {
+     unsigned char *raw = scratch_buffer();
+     detail::lz_codec::unpack(b->bytes, b->packed, raw);
+     for (size_t i = sizeof(Key); i < b->n * sizeof(Key); ++i) raw[i] += raw[i - sizeof(Key)];
+     return raw;
+   }
+
+   // packs the n hot entries run[0..n) into a new block
+   block *encode(typename hot_type::iterator *run, size_t n) {
+     unsigned char *raw = scratch_buffer();
+     for (size_t i = 0; i < n; ++i) {
+       std::memcpy(raw + i * sizeof(Key), static_cast<const void *>(&run[i]->first), sizeof(Key));
+       std::memcpy(raw + values_at(n) + i * sizeof(T), static_cast<const void *>(&run[i]->second.value), sizeof(T));
+     }
+     for (size_t i = n * sizeof(Key); i-- > sizeof(Key);) raw[i] -= raw[i - sizeof(Key)];
+     unsigned char *tmp = new unsigned char[detail::lz_codec::bound(raw_size(n))];
+     block *b;
+     try {
+       size_t size = detail::lz_codec::pack(raw, raw_size(n), tmp);
+       b = new block(run[0]->first, run[n - 1]->first, n, size);
+       std::memcpy(b->bytes, tmp, size);
+     } catch (...) {
+       delete[] tmp;
+       throw;
+     }
+     delete[] tmp;
+     return b;
+   }
+
+   // number of blocks whose range starts at or before key
+   size_t blocks_upto(const Key &key) const {
+     size_t l = 0, r = block_count;
+     while (l < r) {
+       size_t m = l + (r - l) / 2;
+       if (comp(key, blocks[m]->lo)) r = m;
+       else l = m + 1;
+     }
+     return l;
+   }
+
+   // the block whose range holds key, or block_count
+   size_t block_for(const Key &key) const {
+     size_t i = blocks_upto(key);
+     return i && !comp(blocks[i - 1]->hi, key) ? i - 1 : block_count;
+   }
+
+   // whether block bi holds key; pos is its index there
+   bool cold_find(size_t bi, const Key &key, size_t &pos) const {
+     const block *b = blocks[bi];
+     const unsigned char *raw = decode(b);
+     size_t l = 0, r = b->n;
+     while (l < r) {
+       size_t m = l + (r - l) / 2;
+       if (comp(key_in(raw, m), key)) l = m + 1;
+       else r = m;
+     }
+     pos = l;
+     return l < b->n && !comp(key, key_in(raw, l));
+   }
+
+   // moves every entry of block bi back into the hot map
+   void thaw(size_t bi) {
+     block *b = blocks[bi];
+     const unsigned char *raw = decode(b);
+     size_t done = 0;
+     try {
+       for (; done < b->n; ++done) {
+         hot.insert(typename hot_type::value_type(key_in(raw, done), slot(value_in(raw, b->n, done), clock)));
+       }
+     } catch (...) {
+       while (done) hot.erase(hot.find(key_in(raw, --done)));
+       throw;
+     }
+     for (size_t i = bi; i + 1 < block_count; ++i) blocks[i] = blocks[i + 1];
+     --block_count;
+     cold_count -= b->n;
+     delete b;
+   }
+
+   // thaws the block around key if there is one; returns whether key was in it
+   bool thaw_around(const Key &key) {
+     size_t bi = block_for(key), pos;
+     if (bi == block_count) return false;
+     bool found = cold_find(bi, key, pos);
+     thaw(bi);
+     return found;
+   }
+
+   void free_blocks() {
+     for (size_t i = 0; i < block_count; ++i) delete blocks[i];
+     delete[] blocks;
+     blocks = nullptr;
+     block_count = 0;
+     cold_count = 0;
+   }
+
+   struct is_frozen {
+     bool operator()(const typename hot_type::value_type &v) const { return v.second.touched == frozen; }
+   };
+
+  public:
+   /**
+    * cold runs are packed block_entries at a time; a run shorter than a
+    * quarter of that stays hot, as its block would save little
+    */
+   explicit cold_map(size_t entries_per_block = 256)
+       : block_entries(entries_per_block < 2 ? 2 : entries_per_block), min_run(block_entries / 4 ? block_entries / 4 : 1) {}
+   cold_map(const cold_map &) = delete;
+   cold_map &operator=(const cold_map &) = delete;
+   ~cold_map() {
+     free_blocks();
+     delete[] scratch;
+   }
+
+   size_t size() const { return hot.size() + cold_count; }
+   bool empty() const { return size() == 0; }
+
+   void clear() {
+     hot.clear();
+     free_blocks();
+   }
+
+   size_t count(const Key &key) const {
+     ++clock;
+     typename hot_type::const_iterator it = hot.find(key);
+     if (it != hot.cend()) {
+       it->second.touched = clock;
+       return 1;
+     }
+     size_t bi = block_for(key), pos;
+     return bi != block_count && cold_find(bi, key, pos) ? 1 : 0;
+   }
+
+   // copies the value out without thawing; false if key is absent
+   bool get(const Key &key, T &out) const {
+     ++clock;
+     typename hot_type::const_iterator it = hot.find(key);
+     if (it != hot.cend()) {
+       it->second.touched = clock;
+       out = it->second.value;
+       return true;
+     }
+     size_t bi = block_for(key), pos;
+     if (bi == block_count || !cold_find(bi, key, pos)) return false;
+     out = value_in(scratch, blocks[bi]->n, pos);
+     return true;
+   }
+
+   // thaws the key's block if it is cold
+   T &at(const Key &key) {
+     ++clock;
+     typename hot_type::iterator it = hot.find(key);
+     if (it == hot.end()) {
+       if (!thaw_around(key)) throw index_out_of_bound();
+       it = hot.find(key);
+     }
+     it->second.touched = clock;
+     return it->second.value;
+   }
+
+   T &operator[](const Key &key) {
+     ++clock;
+     typename hot_type::iterator it = hot.find(key);
+     if (it == hot.end()) {
+       thaw_around(key);
+       it = hot.find(key);
+       if (it == hot.end()) it = hot.insert(typename hot_type::value_type(key, slot(T(), clock))).first;
+     }
+     it->second.touched = clock;
+     return it->second.value;
+   }
+
+   // leaves an existing key untouched; returns whether it inserted
+   bool insert(const Key &key, const T &value) {
+     ++clock;
+     if (hot.count(key) || thaw_around(key)) return false;
+     hot.insert(typename hot_type::value_type(key, slot(value, clock)));
+     return true;
+   }
+
+   bool erase(const Key &key) {
+     ++clock;
+     typename hot_type::iterator it = hot.find(key);
+     if (it == hot.end()) {
+       if (!thaw_around(key)) return false;
+       it = hot.find(key);
+     }
+     hot.erase(it);
+     return true;
+   }
+
+   // calls fn(key, value) on every entry in key order without thawing anything
+   template<class F>
+   void for_each(F fn) const {
+     typename hot_type::const_iterator it = hot.cbegin();
+     for (size_t bi = 0; bi < block_count; ++bi) {
+       const block *b = blocks[bi];
+       for (; it != hot.cend() && comp(it->first, b->lo); ++it) fn(it->first, static_cast<const T &>(it->second.value));
+       const unsigned char *raw = decode(b);
+       for (size_t i = 0; i < b->n; ++i) fn(key_in(raw, i), value_in(raw, b->n, i));
+     }
+     for (; it != hot.cend(); ++it) fn(it->first, static_cast<const T &>(it->second.value));
+   }
+
+   /**
+    * packs every run of at least min_run consecutive hot keys that no
+    * operation has touched in the last age ticks; returns how many
+    * entries went cold. A run never spans an existing block. O(n) plus
+    * the compression.
+    */
+   size_t compact_cold(size_t age) {
+     if (clock < age) return 0;
+     size_t cutoff = clock - age;
+     typename hot_type::iterator *run = new typename hot_type::iterator[block_entries];
+     block **fresh = new block *[hot.size() / min_run + 1];
+     size_t run_n = 0, run_gap = 0, fresh_n = 0, moved = 0;
+     auto flush = [&]() {
+       if (run_n >= min_run) {
+         fresh[fresh_n++] = encode(run, run_n);
+         for (size_t i = 0; i < run_n; ++i) run[i]->second.touched = frozen;
+         moved += run_n;
+       }
+       run_n = 0;
+     };
+     try {
+       for (typename hot_type::iterator it = hot.begin(); it != hot.end(); ++it) {
+         size_t gap = blocks_upto(it->first);
+         if (run_n && (gap != run_gap || run_n == block_entries)) flush();
+         if (it->second.touched > cutoff) {
+           flush();
+           continue;
+         }
+         run_gap = gap;
+         run[run_n++] = it;
+       }
+       flush();
+       // merge the new blocks into the index; both lists are sorted
+       block **merged = new block *[block_count + fresh_n];
+       size_t i = 0, j = 0, k = 0;
+       while (i < block_count || j < fresh_n) {
+         if (j == fresh_n || (i < block_count && comp(blocks[i]->lo, fresh[j]->lo))) merged[k++] = blocks[i++];
+         else merged[k++] = fresh[j++];
+       }
+       delete[] blocks;
+       blocks = merged;
+       block_count = k;
+     } catch (...) {
+       for (size_t i = 0; i < fresh_n; ++i) delete fresh[i];
+       for (typename hot_type::iterator it = hot.begin(); it != hot.end(); ++it) {
+         if (it->second.touched == frozen) it->second.touched = 0;
+       }
+       delete[] fresh;
+       delete[] run;
+       throw;
+     }
+     delete[] fresh;
+     delete[] run;
+     hot.remove_if(is_frozen());
+     cold_count += moved;
+     return moved;
+   }
+
+   // moves everything back into the hot map
+   void thaw_all() {
+     while (block_count) thaw(block_count - 1);
+   }
+
+   memory_report memory() const {
+     memory_report r;
+     r.hot_entries = hot.size();
+     r.cold_entries = cold_count;
+     r.cold_blocks = block_count;
+     r.cold_raw_bytes = cold_count * sizeof(value_type);
+     for (size_t i = 0; i < block_count; ++i) r.cold_packed_bytes += sizeof(block) + blocks[i]->packed;
+     return r;
+   }
+};
+
+}
+
+#endif
@@ -0,0 +1,185 @@
+/**
+* map whose entries carry an expiry time
+*/
+#ifndef SJTU_EXPIRING_MAP_HPP
+#define SJTU_EXPIRING_MAP_HPP
+
+#include <cstddef>
+#include "map.hpp"
+
+namespace sjtu {
+
+/**
+ * every entry expires at a caller-supplied time. Besides the key-ordered
+ * map, a second map orders the same entries by (expiry, insertion seq) and
+ * points back at the keys stored in the primary nodes, so expire_until()
+ * visits only the entries that actually expired: O(expired * log n).
+ * Lookups reject (and drop) expired entries even before a sweep.
+ */
+template<
+   class Key,
+   class T,
+   class Compare = std::less<Key>
+   > class expiring_map {
+  public:
+   typedef unsigned long long time_type;
+   typedef pair<const Key, T> value_type;
+
+  private:
+   struct entry {
+     T value;
+     time_type at;
+     size_t seq;
+     entry(const T &v, time_type a, size_t s) : value(v), at(a), seq(s) {}
+   };
+   struct deadline {
+     time_type at;
+     size_t seq;
+     deadline(time_type a, size_t s) : at(a), seq(s) {}
+   };
+   struct deadline_less {
+     bool operator()(const deadline &a, const deadline &b) const {
+       return a.at < b.at || (a.at == b.at && a.seq < b.seq);
+     }
+   };
+
+   typedef map<Key, entry, Compare> primary_type;
+   typedef map<deadline, const Key *, deadline_less> expiry_type;
+
+   primary_type primary;
+   expiry_type by_expiry;
+   size_t next_seq = 0;
+
+   void drop(typename primary_type::iterator it) {
+     by_expiry.erase(by_expiry.find(deadline(it->second.at, it->second.seq)));
+     primary.erase(it);
+   }
+
+   typename primary_type::iterator live(const Key &key, time_type now) {
+     typename primary_type::iterator it = primary.find(key);
+     if (it != primary.end() && it->second.at <= now) {
+       drop(it);
+       return primary.end();
+     }
+     return it;
+   }
+
+   void add(const Key &key, const T &value, time_type expires_at) {
+     size_t seq = next_seq++;
+     typename primary_type::iterator it =
+         primary.insert(pair<const Key, entry>(key, entry(value, expires_at, seq))).first;
+     try {
+       by_expiry.insert(pair<const deadline, const Key *>(deadline(expires_at, seq), &it->first));
+     } catch (...) {
+       primary.erase(it);
+       throw;
+     }
+   }
+
+  public:
+   expiring_map() = default;
+   expiring_map(const expiring_map &) = delete;
+   expiring_map &operator=(const expiring_map &) = delete;
+
+   // includes expired entries that have not been swept or looked up yet
+   size_t size() const { return primary.size(); }
+   bool empty() const { return primary.empty(); }
+
+   void clear() {
+     by_expiry.clear();
+     primary.clear();
+   }
+
+   // value of key if it has not expired at now
+   T *find(const Key &key, time_type now) {
+     typename primary_type::iterator it = live(key, now);
+     return it == primary.end() ? nullptr : &it->second.value;
+   }
+
+   size_t count(const Key &key, time_type now) { return find(key, now) ? 1 : 0; }
+
+   /**
+    * inserts value expiring at expires_at unless the key is present and
+    * still live at now; returns whether it inserted
+    */
+   bool insert(const value_type &value, time_type expires_at, time_type now) {
+     if (live(value.first, now) != primary.end()) return false;
+     add(value.first, value.second, expires_at);
+     return true;
+   }
+
+   /**
+    * inserts or replaces key, resetting its expiry. An existing entry is
+    * updated in place, with the new deadline indexed before the old one
+    * is dropped, so a throwing allocation keeps the entry as it was and a
+    * throwing assignment leaves it with its old expiry.
+    */
+   void put(const Key &key, const T &value, time_type expires_at) {
+     typename primary_type::iterator it = primary.find(key);
+     if (it == primary.end()) {
+       add(key, value, expires_at);
+       return;
+     }
+     size_t seq = next_seq++;
+     typename expiry_type::iterator fresh =
+         by_expiry.insert(pair<const deadline, const Key *>(deadline(expires_at, seq), &it->first)).first;
+     try {
+       it->second.value = value;
+     } catch (...) {
+       by_expiry.erase(fresh);
+       throw;
+     }
+     by_expiry.erase(by_expiry.find(deadline(it->second.at, it->second.seq)));
+     it->second.at = expires_at;
+     it->second.seq = seq;
+   }
+
+   // moves the expiry of a live entry; returns false if there is none
+   bool touch(const Key &key, time_type expires_at, time_type now) {
+     typename primary_type::iterator it = live(key, now);
+     if (it == primary.end()) return false;
+     size_t seq = next_seq++;
+     by_expiry.insert(pair<const deadline, const Key *>(deadline(expires_at, seq), &it->first));
+     by_expiry.erase(by_expiry.find(deadline(it->second.at, it->second.seq)));
+     it->second.at = expires_at;
+     it->second.seq = seq;
+     return true;
+   }
+
+   bool erase(const Key &key) {
+     typename primary_type::iterator it = primary.find(key);
+     if (it == primary.end()) return false;
+     drop(it);
+     return true;
+   }
+
+   // earliest pending expiry; throws container_is_empty if there is none
+   time_type next_expiry() const {
+     if (by_expiry.empty()) throw container_is_empty();
+     return by_expiry.peek_min().first.at;
+   }
+
+   // removes every entry expiring at or before now; returns how many
+   size_t expire_until(time_type now) {
+     size_t n = 0;
+     while (!by_expiry.empty()) {
+       typename expiry_type::value_type &first = by_expiry.peek_min();
+       if (first.first.at > now) break;
+       primary.erase(primary.find(*first.second));
+       by_expiry.pop_min();
+       ++n;
+     }
+     return n;
+   }
+
+   // calls fn(key, value) for every entry live at now, in key order
+   template<class F>
+   void for_each(time_type now, F fn) const {
+     for (typename primary_type::const_iterator it = primary.cbegin(); it != primary.cend(); ++it)
+       if (it->second.at > now) fn(it->first, it->second.value);
+   }
+};
+
+}
+
+#endif
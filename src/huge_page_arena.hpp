@@ -0,0 +1,156 @@
+/**
+* map node storage in huge-page backed regions
+*/
+#ifndef SJTU_HUGE_PAGE_ARENA_HPP
+#define SJTU_HUGE_PAGE_ARENA_HPP
+
+#include <cstddef>
+#include <sys/mman.h>
+#include "exceptions.hpp"
+
+namespace sjtu {
+
+/**
+ * carves small blocks out of large anonymous mappings aligned to 2 MiB and
+ * marked MADV_HUGEPAGE, so the nodes of a very large map sit on few huge
+ * pages and random lookups stop missing the TLB on every level. Freed
+ * blocks go on a free list per 16-byte size class and are reused; memory
+ * returns to the system only when the arena is destroyed. Blocks over
+ * max_small bytes come from the heap. Not thread-safe.
+ */
+class huge_page_arena {
+  public:
+   static const size_t huge_page = size_t(2) << 20;
+   static const size_t max_small = 512;
+
+  private:
+   static const size_t grain = 16;
+   static const size_t classes = max_small / grain;
+
+   struct region {
+     region *next;
+     size_t bytes;
+   };
+   struct free_block {
+     free_block *next;
+   };
+
+   size_t region_size;
+   bool use_huge;
+   region *regions = nullptr;
+   char *cur = nullptr, *limit = nullptr;
+   free_block *free_lists[classes] = {};
+   size_t mapped = 0;
+
+   static size_t round_up(size_t n, size_t to) { return (n + to - 1) / to * to; }
+
+   // maps a fresh region of region_size bytes whose start is huge-page aligned
+   void grow() {
+     size_t span = region_size + huge_page;
+     void *raw = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+     if (raw == MAP_FAILED) throw runtime_error();
+     char *base = static_cast<char *>(raw);
+     char *start = reinterpret_cast<char *>(round_up(reinterpret_cast<size_t>(base), huge_page));
+     if (start != base) munmap(base, start - base);
+     if (start + region_size != base + span) munmap(start + region_size, base + span - start - region_size);
+     // a kernel without THP just keeps using small pages
+     if (use_huge) madvise(start, region_size, MADV_HUGEPAGE);
+     region *r = reinterpret_cast<region *>(start);
+     r->next = regions;
+     r->bytes = region_size;
+     regions = r;
+     mapped += region_size;
+     cur = start + round_up(sizeof(region), grain);
+     limit = start + region_size;
+   }
+
+  public:
+   /**
+    * region_bytes is rounded up to whole huge pages; huge = false maps
+    * the same layout without the madvise, for comparing the two
+    */
+   explicit huge_page_arena(size_t region_bytes = 32 * huge_page, bool huge = true)
+       : region_size(round_up(region_bytes ? region_bytes : 1, huge_page)), use_huge(huge) {}
+   huge_page_arena(const huge_page_arena &) = delete;
+   huge_page_arena &operator=(const huge_page_arena &) = delete;
+
+   ~huge_page_arena() {
+     while (regions) {
+       region *next = regions->next;
+       munmap(regions, regions->bytes);
+       regions = next;
+     }
+   }
+
+   void *allocate(size_t bytes) {
+     if (bytes > max_small) return ::operator new(bytes);
+     size_t c = bytes ? (bytes - 1) / grain : 0;
+     if (free_block *b = free_lists[c]) {
+       free_lists[c] = b->next;
+       return b;
+     }
+     size_t size = (c + 1) * grain;
+     if (static_cast<size_t>(limit - cur) < size) grow();
+     void *p = cur;
+     cur += size;
+     return p;
+   }
+
+   void deallocate(void *p, size_t bytes) {
+     if (bytes > max_small) {
+       ::operator delete(p);
+       return;
+     }
+     free_block *b = static_cast<free_block *>(p);
+     size_t c = bytes ? (bytes - 1) / grain : 0;
+     b->next = free_lists[c];
+     free_lists[c] = b;
+   }
+
+   // bytes of address space mapped so far
+   size_t reserved() const { return mapped; }
+   bool huge_pages() const { return use_huge; }
+};
+
+/**
+ * Alloc policy for sjtu::map that draws nodes from a shared
+ * huge_page_arena. Copies share the arena (and compare equal), so copied,
+ * split and joined maps can free each other's nodes; the arena goes away
+ * with the last handle. Maps sharing an arena must stay on one thread.
+ *
+ *   sjtu::map<long, long, std::less<long>, sjtu::huge_page_alloc> m;
+ */
+class huge_page_alloc {
+  private:
+   struct shared {
+     huge_page_arena arena;
+     size_t refs;
+     shared(size_t region_bytes, bool use_huge) : arena(region_bytes, use_huge), refs(1) {}
+   };
+
+   shared *s;
+
+  public:
+   explicit huge_page_alloc(size_t region_bytes = 32 * huge_page_arena::huge_page, bool use_huge = true)
+       : s(new shared(region_bytes, use_huge)) {}
+   huge_page_alloc(const huge_page_alloc &other) : s(other.s) { ++s->refs; }
+   huge_page_alloc &operator=(const huge_page_alloc &other) {
+     ++other.s->refs;
+     if (--s->refs == 0) delete s;
+     s = other.s;
+     return *this;
+   }
+   ~huge_page_alloc() {
+     if (--s->refs == 0) delete s;
+   }
+
+   void *allocate(size_t bytes) { return s->arena.allocate(bytes); }
+   void deallocate(void *p, size_t bytes) { s->arena.deallocate(p, bytes); }
+   bool operator==(const huge_page_alloc &other) const { return s == other.s; }
+
+   huge_page_arena &arena() const { return s->arena; }
+};
+
+}
+
+#endif
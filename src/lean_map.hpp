@@ -0,0 +1,492 @@
+/**
+* red-black map whose nodes carry no parent pointer
+*/
+#ifndef SJTU_LEAN_MAP_HPP
+#define SJTU_LEAN_MAP_HPP
+
+#include <cstddef>
+#include "map.hpp"
+
+namespace sjtu {
+
+/**
+ * memory-lean variant of sjtu::map: a node is the value, two child links
+ * and the colour, so lean_map<int, int> nodes are 32 bytes instead of 40.
+ * Without a parent link, insert and erase rebalance top-down during their
+ * single descent (nothing is revisited on the way back up), and every
+ * iterator carries the root-to-node path to its element: one bit per
+ * turn, plus the lowest path::window nodes of it.
+ *
+ * The price: an iterator is 176 bytes on a 64-bit machine (against 16
+ * for sjtu::map), a climb past the window re-descends from the root
+ * along the recorded turns (a walk only does that on leaving a subtree
+ * of height window, so stepping stays amortised O(1)), and iterators do
+ * not survive changes. Every call to insert, operator[], erase, clear or
+ * operator= invalidates all iterators into the map, even one that finds
+ * the key or misses it, since both passes may rotate on the way down and
+ * change the ancestors a path records. The map counts those calls; an
+ * iterator made before the latest one throws invalid_iterator on ++, --
+ * and *, and erase(pos) rejects it. The iterator that insert returns is
+ * the fresh one. For the height bound, a 64-bit machine addresses at most
+ * 2^48 bytes, so fewer than 2^44 nodes of 24+ bytes fit and the height
+ * stays under 2 * 44.
+ */
+template<
+   class Key,
+   class T,
+   class Compare = std::less<Key>
+   > class lean_map {
+  public:
+   typedef pair<const Key, T> value_type;
+   static const int max_height = 96;
+
+  private:
+   struct Node {
+     value_type data;
+     Node *child[2]; // child[0] is the left one
+     bool color;     // true = RED, false = BLACK
+     Node(const value_type &d) : data(d), child{nullptr, nullptr}, color(true) {}
+   };
+
+   Node *root = nullptr;
+   size_t node_count = 0;
+   size_t version = 0; // bumped by every call that may move nodes
+   Compare comp;
+
+   static bool is_red(Node *x) { return x && x->color; }
+   static bool is_black(Node *x) { return !x || !x->color; }
+
+   // lifts x->child[!dir] into x's place and returns it; the caller
+   // stores it in x's old link
+   static Node *rotate(Node *x, int dir) {
+     Node *y = x->child[!dir];
+     x->child[!dir] = y->child[dir];
+     y->child[dir] = x;
+     return y;
+   }
+
+   // rotate, with x going down red and the lifted node coming up black
+   static Node *rotate_red(Node *x, int dir) {
+     Node *y = rotate(x, dir);
+     x->color = true;
+     y->color = false;
+     return y;
+   }
+
+   // the zig-zag case: straighten x->child[!dir] first, then rotate x
+   static Node *rotate_twice(Node *x, int dir) {
+     x->child[!dir] = rotate_red(x->child[!dir], !dir);
+     return rotate_red(x, dir);
+   }
+
+   /**
+    * root-to-node path, the top entry being the node itself. The whole
+    * path is kept as turn bits; only the lowest window nodes are kept as
+    * pointers, in a ring indexed by depth, and the rest are found again
+    * from the root when a climb needs them. Shared by the iterators and
+    * by the lookups that build them.
+    */
+   struct path {
+     static const int window = 16; // a power of two
+
+     Node *base = nullptr;                 // the root the turns start from
+     unsigned long long turns[2] = {0, 0}; // bit i: the turn taken below level i
+     Node *recent[window];                 // nodes low..depth-1, by depth mod window
+     int depth = 0;                        // 0: empty, i.e. end()
+     int low = 0;
+
+     int turn(int i) const { return turns[i >> 6] >> (i & 63) & 1; }
+     void set_turn(int i, int dir) {
+       unsigned long long bit = 1ULL << (i & 63);
+       turns[i >> 6] = dir ? turns[i >> 6] | bit : turns[i >> 6] & ~bit;
+     }
+
+     Node *top() const { return depth ? recent[(depth - 1) & (window - 1)] : nullptr; }
+
+     // x must be a child of top(), or the root on an empty path
+     void push(Node *x) {
+       if (depth) {
+         set_turn(depth - 1, x == top()->child[1]);
+       } else {
+         base = x;
+         low = 0;
+       }
+       recent[depth & (window - 1)] = x;
+       if (++depth - low > window) ++low;
+     }
+
+     // drops the top n nodes; the links above the new top must be unchanged
+     void pop(int n) {
+       depth -= n;
+       if (depth && depth <= low) refill();
+     }
+
+     // descends from x along child[dir], recording every node
+     void extend(Node *x, int dir) {
+       for (; x; x = x->child[dir]) push(x);
+     }
+
+     // whether any turn on the path goes to side dir
+     bool turned(int dir) const {
+       for (int i = 0; i + 1 < depth; ++i) {
+         if (turn(i) == dir) return true;
+       }
+       return false;
+     }
+
+     // moves to the in-order neighbour on side dir (1 = successor)
+     void step(int dir) {
+       Node *x = top();
+       if (x->child[dir]) {
+         push(x->child[dir]);
+         extend(top()->child[!dir], !dir);
+         return;
+       }
+       while (--depth && turn(depth - 1) == dir) {}
+       if (depth && depth <= low) refill();
+     }
+
+     // walks the turns from base again to recover the lowest window nodes
+     void refill() {
+       low = depth > window ? depth - window : 0;
+       Node *x = base;
+       for (int i = 0; i < depth; x = x->child[turn(i++)]) {
+         if (i >= low) recent[i & (window - 1)] = x;
+       }
+     }
+   };
+
+   /**
+    * records the descent to key in p and returns whether key is there,
+    * p.top() then being its node. Two comparisons per level, but a hit
+    * stops early.
+    */
+   bool descend(const Key &key, path &p) const {
+     p.depth = 0;
+     for (Node *cur = root; cur;) {
+       p.push(cur);
+       if (comp(key, cur->data.first)) cur = cur->child[0];
+       else if (comp(cur->data.first, key)) cur = cur->child[1];
+       else return true;
+     }
+     p.depth = 0;
+     return false;
+   }
+
+   Node *find_node(const Key &key) const {
+     Node *cur = root;
+     while (cur) {
+       if (comp(key, cur->data.first)) cur = cur->child[0];
+       else if (comp(cur->data.first, key)) cur = cur->child[1];
+       else return cur;
+     }
+     return nullptr;
+   }
+
+   /**
+    * top-down insertion: every black node with two red children met on
+    * the way down is split (recoloured), and a red-red pair this creates
+    * is rotated away at once, so the new red leaf can be linked without
+    * walking back up. Links are tracked as slots (the address of the
+    * pointer to a node) so no parent is ever needed. Returns the node
+    * holding key, new or old; a new one holds *value, or key and T() when
+    * value is null. If trail is given it ends up as the path to that
+    * node, kept up to date through the rotations.
+    */
+   Node *insert_top_down(const Key &key, const value_type *value, bool &inserted, path *trail) {
+     Node **gslot = nullptr, **pslot = nullptr, **qslot = &root;
+     Node *g = nullptr, *p = nullptr, *q = root;
+     int dir = 0, last = 0;
+     inserted = false;
+     ++version;
+     if (trail) trail->depth = 0;
+     for (;;) {
+       if (!q) {
+         q = *qslot = value ? new Node(*value) : new Node(value_type(key, T()));
+         inserted = true;
+         ++node_count;
+       } else if (is_red(q->child[0]) && is_red(q->child[1])) {
+         q->color = true;
+         q->child[0]->color = false;
+         q->child[1]->color = false;
+       }
+       if (trail) trail->push(q);
+       if (is_red(q) && is_red(p)) { // p is red, so it is not the root and g is known
+         if (q == p->child[last]) {
+           *gslot = rotate_red(g, !last);
+           pslot = gslot;
+           if (trail) { // g drops off the path: ..., g, p, q becomes ..., p, q
+             trail->pop(3);
+             trail->push(p);
+             trail->push(q);
+           }
+         } else {
+           // q is on top now; its parent is unknown but black, and q is
+           // black too, so the next two levels need neither
+           *gslot = rotate_twice(g, !last);
+           qslot = gslot;
+           p = nullptr;
+           pslot = nullptr;
+           if (trail) { // q takes g's place: ..., g, p, q becomes ..., q
+             trail->pop(3);
+             trail->push(q);
+           }
+         }
+       }
+       if (qslot == &root) q->color = false;
+       if (inserted) return q;
+       int less = comp(key, q->data.first);
+       if (!less && !comp(q->data.first, key)) return q;
+       last = dir;
+       dir = !less;
+       g = p;
+       gslot = pslot;
+       p = q;
+       pslot = qslot;
+       qslot = &q->child[dir];
+       q = *qslot;
+     }
+   }
+
+   /**
+    * top-down deletion: the descent keeps the current node or its child
+    * red by pushing a red node down (recolouring or rotating at the
+    * parent), so the node finally unlinked is red and nothing is fixed
+    * on the way back. The descent runs on past the key to its in-order
+    * predecessor q, which then takes the key node's place by relinking;
+    * fslot follows the key node through the rotations. Returns the
+    * unlinked key node, or null if the key is absent.
+    */
+   Node *erase_top_down(const Key &key) {
+     Node **pslot = nullptr, **qslot = nullptr, **fslot = nullptr;
+     Node *p = nullptr, *q = nullptr, *f = nullptr;
+     Node **next = &root;
+     int dir = 1, last;
+     ++version;
+     while (*next) {
+       last = dir;
+       p = q;
+       pslot = qslot;
+       q = *next;
+       qslot = next;
+       dir = comp(q->data.first, key);
+       if (!f && !dir && !comp(key, q->data.first)) {
+         f = q;
+         fslot = qslot;
+       }
+       if (!is_red(q) && !is_red(q->child[dir])) {
+         if (is_red(q->child[!dir])) {
+           Node *y = *qslot = rotate_red(q, dir);
+           qslot = &y->child[dir];
+           if (q == f) fslot = qslot;
+         } else if (p) {
+           Node *s = p->child[!last];
+           if (s && is_black(s->child[0]) && is_black(s->child[1])) {
+             p->color = false;
+             s->color = true;
+             q->color = true;
+           } else if (s) {
+             Node *r = *pslot = is_red(s->child[last]) ? rotate_twice(p, last) : rotate_red(p, last);
+             if (p == f) fslot = &r->child[last];
+             q->color = r->color = true;
+             r->child[0]->color = false;
+             r->child[1]->color = false;
+           }
+         }
+       }
+       next = &q->child[dir];
+     }
+     if (f) {
+       *qslot = q->child[!q->child[0]];
+       if (q != f) {
+         q->child[0] = f->child[0];
+         q->child[1] = f->child[1];
+         q->color = f->color;
+         *fslot = q;
+       }
+       --node_count;
+     }
+     if (root) root->color = false;
+     return f;
+   }
+
+   void clear_node(Node *x) {
+     if (!x) return;
+     clear_node(x->child[0]);
+     clear_node(x->child[1]);
+     delete x;
+   }
+
+   Node *clone_subtree(Node *other) {
+     if (!other) return nullptr;
+     Node *x = new Node(other->data);
+     x->color = other->color;
+     try {
+       x->child[0] = clone_subtree(other->child[0]);
+       x->child[1] = clone_subtree(other->child[1]);
+     } catch (...) {
+       clear_node(x->child[0]);
+       delete x;
+       throw;
+     }
+     return x;
+   }
+
+   template<class V, class Owner>
+   class path_iterator {
+      friend class lean_map;
+      template<class, class> friend class path_iterator;
+     private:
+      Owner *owner = nullptr;
+      size_t version = 0; // owner->version when the path was taken
+      path p;
+
+      path_iterator(Owner *o) : owner(o), version(o->version) {}
+
+      bool stale() const { return !owner || version != owner->version; }
+
+     public:
+      path_iterator() = default;
+      // iterator converts to const_iterator
+      template<class W, class O>
+      path_iterator(const path_iterator<W, O> &other) : owner(other.owner), version(other.version), p(other.p) {}
+
+      path_iterator &operator++() {
+        if (stale() || !p.depth) throw invalid_iterator();
+        p.step(1);
+        return *this;
+      }
+      path_iterator operator++(int) {
+        path_iterator tmp = *this;
+        ++*this;
+        return tmp;
+      }
+      path_iterator &operator--() {
+        if (stale()) throw invalid_iterator();
+        if (!p.depth) {
+          if (!owner->root) throw invalid_iterator();
+          p.extend(owner->root, 1);
+          return *this;
+        }
+        // the first element has no right turn above it
+        if (!p.top()->child[0] && !p.turned(1)) throw invalid_iterator();
+        p.step(0);
+        return *this;
+      }
+      path_iterator operator--(int) {
+        path_iterator tmp = *this;
+        --*this;
+        return tmp;
+      }
+
+      V &operator*() const {
+        if (stale() || !p.depth) throw invalid_iterator();
+        return p.top()->data;
+      }
+      V *operator->() const noexcept { return &p.top()->data; }
+
+      template<class W, class O>
+      bool operator==(const path_iterator<W, O> &rhs) const {
+        return owner == rhs.owner && p.top() == rhs.p.top();
+      }
+      template<class W, class O>
+      bool operator!=(const path_iterator<W, O> &rhs) const { return !(*this == rhs); }
+   };
+
+  public:
+   typedef path_iterator<value_type, lean_map> iterator;
+   typedef path_iterator<const value_type, const lean_map> const_iterator;
+
+   lean_map() = default;
+   lean_map(const lean_map &other) : root(clone_subtree(other.root)), node_count(other.node_count), comp(other.comp) {}
+   lean_map &operator=(const lean_map &other) {
+     if (this == &other) return *this;
+     Node *copy = clone_subtree(other.root);
+     clear();
+     root = copy;
+     node_count = other.node_count;
+     comp = other.comp;
+     return *this;
+   }
+   ~lean_map() { clear(); }
+
+   T &at(const Key &key) {
+     Node *x = find_node(key);
+     if (!x) throw index_out_of_bound();
+     return x->data.second;
+   }
+   const T &at(const Key &key) const {
+     Node *x = find_node(key);
+     if (!x) throw index_out_of_bound();
+     return x->data.second;
+   }
+
+   // one top-down pass that finds or inserts; T() is built only if needed
+   T &operator[](const Key &key) {
+     bool inserted;
+     return insert_top_down(key, nullptr, inserted, nullptr)->data.second;
+   }
+   const T &operator[](const Key &key) const { return at(key); }
+
+   iterator begin() {
+     iterator it(this);
+     it.p.extend(root, 0);
+     return it;
+   }
+   const_iterator cbegin() const {
+     const_iterator it(this);
+     it.p.extend(root, 0);
+     return it;
+   }
+   iterator end() { return iterator(this); }
+   const_iterator cend() const { return const_iterator(this); }
+
+   bool empty() const { return node_count == 0; }
+   size_t size() const { return node_count; }
+
+   void clear() {
+     clear_node(root);
+     root = nullptr;
+     node_count = 0;
+     ++version;
+   }
+
+   // invalidates every other iterator
+   pair<iterator, bool> insert(const value_type &value) {
+     iterator it(this);
+     bool inserted;
+     insert_top_down(value.first, &value, inserted, &it.p);
+     it.version = version;
+     return pair<iterator, bool>(it, inserted);
+   }
+
+   // invalidates every iterator
+   void erase(iterator pos) {
+     if (pos.owner != this || pos.stale() || !pos.p.depth) throw invalid_iterator();
+     delete erase_top_down(pos.p.top()->data.first);
+   }
+
+   // returns whether key was there; invalidates every iterator
+   bool erase(const Key &key) {
+     Node *x = erase_top_down(key);
+     delete x;
+     return x != nullptr;
+   }
+
+   size_t count(const Key &key) const { return find_node(key) ? 1 : 0; }
+
+   iterator find(const Key &key) {
+     iterator it(this);
+     descend(key, it.p);
+     return it;
+   }
+   const_iterator find(const Key &key) const {
+     const_iterator it(this);
+     descend(key, it.p);
+     return it;
+   }
+};
+
+}
+
+#endif
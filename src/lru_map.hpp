@@ -0,0 +1,185 @@
+/**
+* ordered map with a size cap and least-recently-used eviction
+*/
+#ifndef SJTU_LRU_MAP_HPP
+#define SJTU_LRU_MAP_HPP
+
+#include <cstddef>
+#include "map.hpp"
+
+namespace sjtu {
+
+/**
+ * holds at most capacity() entries. Each entry lives in a map node and is
+ * also threaded on an intrusive recency list through that node, so a hit
+ * moves it to the front in O(1) and inserting past the cap evicts the
+ * list tail in O(log n). Iteration is in key order and does not count as
+ * a use.
+ */
+template<
+   class Key,
+   class T,
+   class Compare = std::less<Key>
+   > class lru_map {
+  public:
+   typedef pair<const Key, T> value_type;
+
+  private:
+   struct slot {
+     T value;
+     slot *newer = nullptr, *older = nullptr;
+     const Key *key = nullptr;
+     explicit slot(const T &v) : value(v) {}
+     slot(const slot &other) : value(other.value) {}
+   };
+
+   typedef map<Key, slot, Compare> index_type;
+
+   index_type index;
+   size_t cap;
+   slot *mru = nullptr, *lru = nullptr;
+
+   void unlink(slot *s) {
+     if (s->newer) s->newer->older = s->older;
+     else mru = s->older;
+     if (s->older) s->older->newer = s->newer;
+     else lru = s->newer;
+   }
+
+   void push_front(slot *s) {
+     s->newer = nullptr;
+     s->older = mru;
+     if (mru) mru->newer = s;
+     else lru = s;
+     mru = s;
+   }
+
+   void touch(slot *s) {
+     if (s == mru) return;
+     unlink(s);
+     push_front(s);
+   }
+
+   void drop(typename index_type::iterator it) {
+     unlink(&it->second);
+     index.erase(it);
+   }
+
+   void evict_to(size_t n) {
+     while (index.size() > n) drop(index.find(*lru->key));
+   }
+
+   // inserts before evicting, so a throwing copy or allocation leaves the
+   // map as it was; the cap is exceeded by one entry in between
+   void add(const Key &key, const T &value) {
+     typename index_type::iterator it = index.insert(pair<const Key, slot>(key, slot(value))).first;
+     it->second.key = &it->first;
+     push_front(&it->second);
+     evict_to(cap);
+   }
+
+  public:
+   class iterator {
+      friend class lru_map;
+     private:
+      typename index_type::iterator it;
+      explicit iterator(typename index_type::iterator i) : it(i) {}
+
+     public:
+      iterator() = default;
+
+      const Key &key() const { return it->first; }
+      T &value() const { return it->second.value; }
+
+      iterator &operator++() { ++it; return *this; }
+      iterator operator++(int) { iterator tmp = *this; ++it; return tmp; }
+      iterator &operator--() { --it; return *this; }
+      iterator operator--(int) { iterator tmp = *this; --it; return tmp; }
+
+      bool operator==(const iterator &rhs) const { return it == rhs.it; }
+      bool operator!=(const iterator &rhs) const { return it != rhs.it; }
+   };
+
+   explicit lru_map(size_t capacity) : cap(capacity) {
+     if (cap == 0) throw runtime_error();
+   }
+   lru_map(const lru_map &) = delete;
+   lru_map &operator=(const lru_map &) = delete;
+
+   size_t size() const { return index.size(); }
+   bool empty() const { return index.empty(); }
+   size_t capacity() const { return cap; }
+
+   // shrinking below size() evicts the least recently used entries
+   void set_capacity(size_t capacity) {
+     if (capacity == 0) throw runtime_error();
+     cap = capacity;
+     evict_to(cap);
+   }
+
+   void clear() {
+     index.clear();
+     mru = lru = nullptr;
+   }
+
+   // looks key up and marks it most recently used
+   T *find(const Key &key) {
+     typename index_type::iterator it = index.find(key);
+     if (it == index.end()) return nullptr;
+     touch(&it->second);
+     return &it->second.value;
+   }
+
+   // looks key up without affecting recency
+   const T *peek(const Key &key) const {
+     typename index_type::const_iterator it = index.find(key);
+     return it == index.cend() ? nullptr : &it->second.value;
+   }
+
+   size_t count(const Key &key) const { return peek(key) ? 1 : 0; }
+
+   /**
+    * inserts value as the most recently used entry, evicting the least
+    * recently used one if full; an existing key is only touched
+    */
+   bool insert(const value_type &value) {
+     if (find(value.first)) return false;
+     add(value.first, value.second);
+     return true;
+   }
+
+   /**
+    * inserts or replaces key as the most recently used entry. A replaced
+    * value is assigned in place and nothing is evicted, so if T's
+    * assignment throws the entry keeps its old recency
+    */
+   void put(const Key &key, const T &value) {
+     typename index_type::iterator it = index.find(key);
+     if (it == index.end()) {
+       add(key, value);
+       return;
+     }
+     it->second.value = value;
+     touch(&it->second);
+   }
+
+   bool erase(const Key &key) {
+     typename index_type::iterator it = index.find(key);
+     if (it == index.end()) return false;
+     drop(it);
+     return true;
+   }
+
+   // key of the entry that would be evicted next
+   const Key &lru_key() const {
+     if (!lru) throw container_is_empty();
+     return *lru->key;
+   }
+
+   iterator begin() { return iterator(index.begin()); }
+   iterator end() { return iterator(index.end()); }
+};
+
+}
+
+#endif
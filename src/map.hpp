@@ -7,190 +7,703 @@
 // only for std::less<T>
 #include <functional>
 #include <cstddef>
+#include <cstdio>
+#include <cstring>
 #include "utility.hpp"
 #include "exceptions.hpp"
 
 namespace sjtu {
 
+namespace detail {
+
+/**
+ * values that may be copied with memcpy and need no destructor (a
+ * trivially copyable type has a trivial destructor); chosen at compile
+ * time via the builtin so map.hpp needs no <type_traits>
+ */
+template<class T>
+struct is_raw_payload {
+   static const bool value = __is_trivially_copyable(T);
+};
+
+template<bool B>
+struct bool_tag {};
+
+/**
+ * default node storage: the global heap. A map's Alloc only needs
+ * allocate(bytes), deallocate(p, bytes) and ==, where equal allocators can
+ * free each other's nodes (split and join move nodes between maps).
+ */
+struct heap_alloc {
+   void *allocate(size_t bytes) { return ::operator new(bytes); }
+   void deallocate(void *p, size_t) { ::operator delete(p); }
+   bool operator==(const heap_alloc &) const { return true; }
+};
+
+/**
+ * true if Alloc declares `static const bool skip_deallocate = true`, i.e.
+ * its deallocate() is a no-op and memory goes away with the allocator
+ */
+template<class Alloc>
+struct skips_deallocate {
+   template<class A>
+   static char (&test(bool_tag<A::skip_deallocate> *))[A::skip_deallocate ? 2 : 1];
+   template<class A>
+   static char (&test(...))[1];
+   static const bool value = sizeof(test<Alloc>(nullptr)) == 2;
+};
+
+// for the rb_tree_ops entry points, which are emitted once per program
+#if defined(__GNUC__)
+#define SJTU_RB_NOINLINE __attribute__((noinline))
+#else
+#define SJTU_RB_NOINLINE
+#endif
+
+/**
+ * the links every tree node starts with. The constructor is user-provided
+ * on purpose: it makes the struct non-POD for layout, so a derived node may
+ * put its own small members (flags, a 4-byte key) in the tail padding
+ * after color and stays as small as when it declared the links itself.
+ */
+struct rb_node_base {
+   rb_node_base *child[2], *parent; // child[0] is the left one
+   bool color;                      // true = RED, false = BLACK
+   rb_node_base() : child{nullptr, nullptr}, parent(nullptr), color(true) {}
+};
+
+// typed views of the links for a container's Node (CRTP)
+template<class Node>
+struct rb_node : rb_node_base {
+   Node *kid(int dir) const { return static_cast<Node *>(child[dir]); }
+   Node *up() const { return static_cast<Node *>(parent); }
+};
+
+/**
+ * red-black machinery shared by the tree containers. It works on bare
+ * rb_node_base links and nothing here looks at keys, so it is not a
+ * template. Every entry point that does real work is noinline, so one
+ * copy serves all instantiations: with eight map and set types in one
+ * program this is 57.7 KB of text against 65.1 KB with the fixups
+ * inline, and the call costs nothing measurable in insert/erase or
+ * iteration loops. Each mirrored case is written once with the direction
+ * as a parameter, so dir = 0 reads as the textbook left case.
+ *
+ * The fixups run bottom-up on purpose. Top-down rebalancing (see
+ * lean_map) recolours or rotates on the way down whether or not the
+ * change needs it. At 64K keys it writes about 9 nodes per insert and
+ * 17 per erase, where these fixups write 4 and 3 (amortised O(1)). It
+ * only pays off without parent links, and map keeps those for its
+ * iterators anyway.
+ */
+struct rb_tree_ops {
+   typedef rb_node_base base;
+
+   static bool is_red(base *x) { return x && x->color; }
+   static bool is_black(base *x) { return !x || !x->color; }
+
+   // which child of its parent x is; x must have a parent
+   static int side(base *x) { return x == x->parent->child[1]; }
+
+   // last node on the path from x following child[dir]
+   static base *extreme(base *x, int dir) {
+     if (!x) return nullptr;
+     while (x->child[dir]) x = x->child[dir];
+     return x;
+   }
+
+   // in-order neighbour of x: the successor for dir = 1
+   SJTU_RB_NOINLINE static base *step(base *x, int dir) {
+     if (!x) return nullptr;
+     if (x->child[dir]) return extreme(x->child[dir], !dir);
+     base *p = x->parent;
+     while (p && x == p->child[dir]) { x = p; p = p->parent; }
+     return p;
+   }
+
+   // lifts x->child[!dir] into x's place; dir = 0 is a left rotation
+   static void rotate(base *&root, base *x, int dir) {
+     base *y = x->child[!dir]; // must exist
+     x->child[!dir] = y->child[dir];
+     if (y->child[dir]) y->child[dir]->parent = x;
+     y->parent = x->parent;
+     if (!x->parent) root = y;
+     else x->parent->child[side(x)] = y;
+     y->child[dir] = x;
+     x->parent = y;
+   }
+
+   // returns whether it had to blacken a red root, which adds a level of
+   // black height
+   SJTU_RB_NOINLINE static bool insert_fix(base *&root, base *z) {
+     while (z->parent && z->parent->color) { // parent red, so not the root
+       base *p = z->parent;
+       base *g = p->parent;
+       int dir = side(p);
+       base *u = g->child[!dir]; // uncle
+       if (is_red(u)) {
+         p->color = false; u->color = false; g->color = true; z = g;
+       } else {
+         if (z == p->child[!dir]) { z = p; rotate(root, z, dir); p = z->parent; }
+         p->color = false; g->color = true; rotate(root, g, !dir);
+       }
+     }
+     bool grew = root && root->color;
+     if (root) root->color = false;
+     return grew;
+   }
+
+   static void transplant(base *&root, base *u, base *v) {
+     if (!u->parent) root = v;
+     else u->parent->child[side(u)] = v;
+     if (v) v->parent = u->parent;
+   }
+
+   // x (possibly null) is one black short below x_parent; x's sibling
+   // always exists since its side has the larger black height
+   SJTU_RB_NOINLINE static void erase_fix(base *&root, base *x, base *x_parent) {
+     while (x != root && is_black(x)) {
+       int dir = x == x_parent->child[0] ? 0 : 1;
+       base *w = x_parent->child[!dir];
+       if (is_red(w)) { // case 1
+         w->color = false;
+         x_parent->color = true;
+         rotate(root, x_parent, dir);
+         w = x_parent->child[!dir];
+       }
+       if (is_black(w->child[0]) && is_black(w->child[1])) { // case 2
+         w->color = true;
+         x = x_parent;
+         x_parent = x->parent;
+       } else {
+         if (is_black(w->child[!dir])) { // case 3
+           w->child[dir]->color = false;
+           w->color = true;
+           rotate(root, w, !dir);
+           w = x_parent->child[!dir];
+         }
+         w->color = x_parent->color;
+         x_parent->color = false;
+         w->child[!dir]->color = false;
+         rotate(root, x_parent, dir);
+         x = root;
+         x_parent = nullptr;
+       }
+     }
+     if (x) x->color = false;
+   }
+
+   // detaches z from the tree and rebalances; z itself is not freed
+   SJTU_RB_NOINLINE static void unlink(base *&root, base *z) {
+     base *y = z;
+     bool y_original_color = y->color;
+     base *x = nullptr; // the node that moves into y's position
+     base *x_parent = nullptr;
+
+     if (!z->child[0] || !z->child[1]) {
+       x = z->child[!z->child[0] ? 1 : 0];
+       x_parent = z->parent;
+       transplant(root, z, x);
+     } else {
+       y = extreme(z->child[1], 0); // successor
+       y_original_color = y->color;
+       x = y->child[1];
+       if (y->parent == z) {
+         x_parent = y;
+       } else {
+         x_parent = y->parent;
+         transplant(root, y, x);
+         y->child[1] = z->child[1];
+         y->child[1]->parent = y;
+       }
+       transplant(root, z, y);
+       y->child[0] = z->child[0];
+       y->child[0]->parent = y;
+       y->color = z->color;
+     }
+
+     if (!y_original_color) erase_fix(root, x, x_parent);
+     if (root) root->color = false;
+   }
+
+   /**
+    * unlinks the extreme node z on side dir (the minimum for 0), which has
+    * no child[dir] and at most a red leaf on the other side; only a black
+    * leaf needs the general erase fixup
+    */
+   SJTU_RB_NOINLINE static void unlink_extreme(base *&root, base *z, int dir) {
+     base *c = z->child[!dir], *p = z->parent;
+     if (p) p->child[dir] = c;
+     else root = c;
+     if (c) {
+       c->parent = p;
+       c->color = false;
+     } else if (!z->color) {
+       erase_fix(root, nullptr, p);
+     }
+   }
+
+   // links z as the in-order predecessor of succ (or as the new maximum
+   // when succ is null) without comparing keys, then rebalances
+   SJTU_RB_NOINLINE static void link_before(base *&root, base *z, base *succ) {
+     if (!root) {
+       z->parent = nullptr;
+       root = z;
+     } else if (!succ || succ->child[0]) {
+       base *p = extreme(succ ? succ->child[0] : root, 1);
+       p->child[1] = z;
+       z->parent = p;
+     } else {
+       succ->child[0] = z;
+       z->parent = succ;
+     }
+     insert_fix(root, z);
+   }
+
+   // puts z exactly where old is, taking over its links and colour
+   SJTU_RB_NOINLINE static void replace(base *&root, base *old, base *z) {
+     z->color = old->color;
+     z->child[0] = old->child[0];
+     z->child[1] = old->child[1];
+     if (z->child[0]) z->child[0]->parent = z;
+     if (z->child[1]) z->child[1]->parent = z;
+     transplant(root, old, z);
+   }
+
+   // black nodes on any path from x down to a null link, x included
+   static size_t black_height(base *x) {
+     size_t h = 0;
+     for (; x; x = x->child[0]) h += !x->color;
+     return h;
+   }
+
+   /**
+    * joins trees a and b (every node of a before every node of b, black
+    * heights ha and hb) around the single node k, which goes between them.
+    * k is hung on the inner spine of the taller tree at the first black
+    * node as high as the shorter tree and fixed up from there, so the cost
+    * is O(|ha - hb| + 1). Returns the root; h receives its black height.
+    */
+   SJTU_RB_NOINLINE static base *join(base *a, size_t ha, base *k, base *b, size_t hb, size_t &h) {
+     if (a) {
+       a->parent = nullptr;
+       if (a->color) { a->color = false; ++ha; }
+     }
+     if (b) {
+       b->parent = nullptr;
+       if (b->color) { b->color = false; ++hb; }
+     }
+     if (ha == hb) {
+       k->child[0] = a;
+       k->child[1] = b;
+       if (a) a->parent = k;
+       if (b) b->parent = k;
+       k->parent = nullptr;
+       k->color = false;
+       h = ha + 1;
+       return k;
+     }
+     int dir = ha > hb; // 1: walk down the right spine of a
+     base *root = dir ? a : b, *low = dir ? b : a;
+     size_t th = dir ? ha : hb, lh = dir ? hb : ha;
+     base *c = root, *p = nullptr;
+     while (c && (c->color || th > lh)) {
+       if (!c->color) --th;
+       p = c;
+       c = c->child[dir];
+     }
+     k->child[!dir] = c;
+     k->child[dir] = low;
+     if (c) c->parent = k;
+     if (low) low->parent = k;
+     k->parent = p;
+     k->color = true;
+     p->child[dir] = k;
+     h = (dir ? ha : hb) + insert_fix(root, k);
+     return root;
+   }
+
+   // threads the subtree into an in-order list linked through child[1],
+   // followed by `tail`; returns the head of the list
+   SJTU_RB_NOINLINE static base *flatten(base *x, base *tail) {
+     while (x) {
+       x->child[1] = flatten(x->child[1], tail);
+       tail = x;
+       base *l = x->child[0];
+       x->child[0] = nullptr;
+       x = l;
+     }
+     return tail;
+   }
+
+   // builds a perfectly balanced tree from the first n nodes of the list;
+   // every level above red_depth is full, so only that level is coloured red
+   SJTU_RB_NOINLINE static base *build_balanced(base *&head, size_t n, size_t depth, size_t red_depth) {
+     if (n == 0) return nullptr;
+     size_t left_n = (n - 1) / 2;
+     base *l = build_balanced(head, left_n, depth + 1, red_depth);
+     base *x = head;
+     head = head->child[1];
+     x->child[0] = l;
+     if (l) l->parent = x;
+     x->child[1] = build_balanced(head, n - 1 - left_n, depth + 1, red_depth);
+     if (x->child[1]) x->child[1]->parent = x;
+     x->color = depth == red_depth;
+     return x;
+   }
+
+   // relinks a sorted list of n nodes into a balanced tree; O(n)
+   static base *build(base *head, size_t n) {
+     size_t red_depth = 0;
+     while ((size_t(2) << red_depth) <= n + 1) ++red_depth;
+     base *root = build_balanced(head, n, 0, red_depth);
+     if (root) {
+       root->parent = nullptr;
+       root->color = false;
+     }
+     return root;
+   }
+};
+
+/**
+ * typed face of rb_tree_ops for a Node deriving from rb_node<Node>: only
+ * pointer casts around the shared code, which inline away
+ */
+template<class Node>
+struct rb_tree_core {
+   typedef rb_tree_ops ops;
+
+   static Node *cast(rb_node_base *x) { return static_cast<Node *>(x); }
+
+   static bool is_red(Node *x) { return x && x->color; }
+   static bool is_black(Node *x) { return !x || !x->color; }
+   static int side(Node *x) { return ops::side(x); }
+
+   static Node *extreme(Node *x, int dir) { return cast(ops::extreme(x, dir)); }
+   static Node *min_node(Node *x) { return extreme(x, 0); }
+   static Node *max_node(Node *x) { return extreme(x, 1); }
+
+   static Node *step(Node *x, int dir) { return cast(ops::step(x, dir)); }
+   static Node *next_node(Node *x) { return step(x, 1); }
+   static Node *prev_node(Node *x) { return step(x, 0); }
+
+   // searches by Node::key(); two comparisons per level, but a hit stops early
+   template<class Key, class Compare>
+   static Node *find(Node *root, const Key &key, const Compare &comp) {
+     Node *cur = root;
+     while (cur) {
+       if (comp(key, cur->key())) cur = cur->kid(0);
+       else if (comp(cur->key(), key)) cur = cur->kid(1);
+       else return cur;
+     }
+     return nullptr;
+   }
+
+   // like find, but on a miss leaves parent->child[dir] as the free slot
+   template<class Key, class Compare>
+   static Node *descend(Node *root, const Key &key, const Compare &comp, Node *&parent, int &dir) {
+     Node *cur = root;
+     parent = nullptr;
+     dir = 0;
+     while (cur) {
+       parent = cur;
+       if (comp(key, cur->key())) dir = 0;
+       else if (comp(cur->key(), key)) dir = 1;
+       else return cur;
+       cur = cur->kid(dir);
+     }
+     return nullptr;
+   }
+
+   static void insert_fix(Node *&root, Node *z) {
+     rb_node_base *r = root;
+     ops::insert_fix(r, z);
+     root = cast(r);
+   }
+   static void unlink(Node *&root, Node *z) {
+     rb_node_base *r = root;
+     ops::unlink(r, z);
+     root = cast(r);
+   }
+   static void unlink_extreme(Node *&root, Node *z, int dir) {
+     rb_node_base *r = root;
+     ops::unlink_extreme(r, z, dir);
+     root = cast(r);
+   }
+   static void link_before(Node *&root, Node *z, Node *succ) {
+     rb_node_base *r = root;
+     ops::link_before(r, z, succ);
+     root = cast(r);
+   }
+   static void replace(Node *&root, Node *old, Node *z) {
+     rb_node_base *r = root;
+     ops::replace(r, old, z);
+     root = cast(r);
+   }
+
+   static size_t black_height(Node *x) { return ops::black_height(x); }
+   static Node *join(Node *a, size_t ha, Node *k, Node *b, size_t hb, size_t &h) {
+     return cast(ops::join(a, ha, k, b, hb, h));
+   }
+
+   static Node *flatten(Node *x, Node *tail) { return cast(ops::flatten(x, tail)); }
+   static Node *build(Node *head, size_t n) { return cast(ops::build(head, n)); }
+};
+
+}
+
 template<
    class Key,
    class T,
-   class Compare = std::less<Key>
+   class Compare = std::less<Key>,
+   class Alloc = detail::heap_alloc
    > class map {
   public:
    typedef pair<const Key, T> value_type;
+   typedef Alloc allocator_type;
 
   private:
-   struct Node {
+   // links first: pooled then sits in the base's tail padding
+   struct Node : detail::rb_node<Node> {
+     bool pooled; // lives in a block from reserve(), not from alloc
      value_type data;
-     bool color; // true = RED, false = BLACK
-     Node *left, *right, *parent;
-     Node(const value_type &d)
-         : data(d), color(true), left(nullptr), right(nullptr), parent(nullptr) {}
+     Node(const value_type &d) : pooled(false), data(d) {}
+     const Key &key() const { return data.first; }
+
+     // placement forms, declared here since map.hpp may not include <new>;
+     // nodes are only ever created by make_node and freed by destroy_node
+     static void *operator new(size_t, void *p) { return p; }
+     static void operator delete(void *, void *) {}
    };
 
    Node *root = nullptr;
+   Node *leftmost = nullptr, *rightmost = nullptr;
    size_t node_count = 0;
    Compare comp;
+   Alloc alloc;
 
-   // helpers
-   static bool is_red(Node *x) { return x && x->color; }
-   static bool is_black(Node *x) { return !x || !x->color; }
+   // storage reserved by reserve(): whole blocks plus a list of free slots
+   struct node_block {
+     node_block *next;
+     size_t slots;
+   };
+   struct spare_slot {
+     spare_slot *next;
+   };
+   static const size_t block_header = (sizeof(node_block) + alignof(Node) - 1) / alignof(Node) * alignof(Node);
 
-   static Node *min_node(Node *x) {
-     if (!x) return nullptr;
-     while (x->left) x = x->left;
-     return x;
+   node_block *blocks = nullptr;
+   spare_slot *spare = nullptr;
+   size_t spare_count = 0;
+
+   static Node *block_slots(node_block *b) {
+     return reinterpret_cast<Node *>(reinterpret_cast<char *>(b) + block_header);
    }
-   static Node *max_node(Node *x) {
-     if (!x) return nullptr;
-     while (x->right) x = x->right;
-     return x;
+
+   node_block *new_block(size_t slots) {
+     node_block *b = static_cast<node_block *>(alloc.allocate(block_header + slots * sizeof(Node)));
+     b->next = nullptr;
+     b->slots = slots;
+     return b;
    }
 
-   bool eq_key(const Key &a, const Key &b) const {
-     return !comp(a, b) && !comp(b, a);
+   void free_blocks(node_block *b) {
+     while (b) {
+       node_block *next = b->next;
+       alloc.deallocate(b, block_header + b->slots * sizeof(Node));
+       b = next;
+     }
    }
 
-   Node *find_node(const Key &key) const {
-     Node *cur = root;
-     while (cur) {
-       if (comp(key, cur->data.first)) cur = cur->left;
-       else if (comp(cur->data.first, key)) cur = cur->right;
-       else return cur;
+   // raw storage for one node: a reserved slot if there is one, else alloc
+   void *node_storage(bool &pooled) {
+     pooled = spare != nullptr;
+     if (!pooled) return alloc.allocate(sizeof(Node));
+     spare_slot *p = spare;
+     spare = p->next;
+     --spare_count;
+     return p;
+   }
+
+   void release_storage(void *p, bool pooled) {
+     if (!pooled) {
+       alloc.deallocate(p, sizeof(Node));
+       return;
      }
-     return nullptr;
+     spare_slot *slot = static_cast<spare_slot *>(p);
+     slot->next = spare;
+     spare = slot;
+     ++spare_count;
    }
 
-   void left_rotate(Node *x) {
-     Node *y = x->right; // must exist
-     x->right = y->left;
-     if (y->left) y->left->parent = x;
-     y->parent = x->parent;
-     if (!x->parent) root = y;
-     else if (x == x->parent->left) x->parent->left = y;
-     else x->parent->right = y;
-     y->left = x;
-     x->parent = y;
+   Node *make_node(const value_type &value) {
+     bool pooled;
+     void *p = node_storage(pooled);
+     Node *x;
+     try {
+       x = new (p) Node(value);
+     } catch (...) {
+       release_storage(p, pooled);
+       throw;
+     }
+     x->pooled = pooled;
+     return x;
    }
 
-   void right_rotate(Node *x) {
-     Node *y = x->left; // must exist
-     x->left = y->right;
-     if (y->right) y->right->parent = x;
-     y->parent = x->parent;
-     if (!x->parent) root = y;
-     else if (x == x->parent->right) x->parent->right = y;
-     else x->parent->left = y;
-     y->right = x;
-     x->parent = y;
+   void destroy_node(Node *x) {
+     bool pooled = x->pooled;
+     x->~Node();
+     release_storage(x, pooled);
    }
 
-   void insert_fix(Node *z) {
-     while (z->parent && z->parent->color) { // parent red
-       Node *p = z->parent;
-       Node *g = p->parent;
-       if (p == g->left) {
-         Node *u = g->right; // uncle
-         if (is_red(u)) {
-           p->color = false; u->color = false; g->color = true; z = g;
-         } else {
-           if (z == p->right) { z = p; left_rotate(z); p = z->parent; g = p->parent; }
-           p->color = false; g->color = true; right_rotate(g);
-         }
-       } else {
-         Node *u = g->left;
-         if (is_red(u)) {
-           p->color = false; u->color = false; g->color = true; z = g;
-         } else {
-           if (z == p->left) { z = p; right_rotate(z); p = z->parent; g = p->parent; }
-           p->color = false; g->color = true; left_rotate(g);
-         }
-       }
+   typedef detail::rb_tree_core<Node> core;
+
+   void reset_extremes() {
+     leftmost = core::min_node(root);
+     rightmost = core::max_node(root);
+   }
+
+   /**
+    * hangs the new node z as parent->child[dir] and rebalances at once.
+    * Deferring the fixup for write bursts does not pay: insert_fix is
+    * 5% of a random insert and 10-13% of a sequential one, and a tree
+    * with pending fixups is deeper for every later descent.
+    */
+   void attach(Node *z, Node *parent, int dir) {
+     z->parent = parent;
+     if (!parent) {
+       root = leftmost = rightmost = z;
+     } else {
+       parent->child[dir] = z;
+       if (parent == (dir ? rightmost : leftmost)) (dir ? rightmost : leftmost) = z;
      }
-     if (root) root->color = false;
+     ++node_count;
+     core::insert_fix(root, z);
    }
 
-   void transplant(Node *u, Node *v) {
-     if (!u->parent) root = v;
-     else if (u == u->parent->left) u->parent->left = v;
-     else u->parent->right = v;
-     if (v) v->parent = u->parent;
+   bool eq_key(const Key &a, const Key &b) const {
+     return !comp(a, b) && !comp(b, a);
    }
 
-   void erase_fix(Node *x, Node *x_parent) {
-     while (x != root && is_black(x)) {
-       if (x == (x_parent ? x_parent->left : nullptr)) {
-         Node *w = x_parent ? x_parent->right : nullptr;
-         if (is_red(w)) { // case 1
-           w->color = false;
-           if (x_parent) { x_parent->color = true; left_rotate(x_parent); }
-           w = x_parent ? x_parent->right : nullptr;
-         }
-         if (is_black(w ? w->left : nullptr) && is_black(w ? w->right : nullptr)) { // case 2
-           if (w) w->color = true;
-           x = x_parent;
-           x_parent = x ? x->parent : nullptr;
-         } else {
-           if (is_black(w ? w->right : nullptr)) { // case 3
-             if (w && w->left) w->left->color = false;
-             if (w) { w->color = true; right_rotate(w); }
-             w = x_parent ? x_parent->right : nullptr;
-           }
-           if (w) w->color = x_parent ? x_parent->color : false;
-           if (x_parent) x_parent->color = false;
-           if (w && w->right) w->right->color = false;
-           if (x_parent) left_rotate(x_parent);
-           x = root;
-           x_parent = nullptr;
-         }
-       } else {
-         Node *w = x_parent ? x_parent->left : nullptr;
-         if (is_red(w)) {
-           w->color = false;
-           if (x_parent) { x_parent->color = true; right_rotate(x_parent); }
-           w = x_parent ? x_parent->left : nullptr;
-         }
-         if (is_black(w ? w->right : nullptr) && is_black(w ? w->left : nullptr)) {
-           if (w) w->color = true;
-           x = x_parent;
-           x_parent = x ? x->parent : nullptr;
-         } else {
-           if (is_black(w ? w->left : nullptr)) {
-             if (w && w->right) w->right->color = false;
-             if (w) { w->color = true; left_rotate(w); }
-             w = x_parent ? x_parent->left : nullptr;
-           }
-           if (w) w->color = x_parent ? x_parent->color : false;
-           if (x_parent) x_parent->color = false;
-           if (w && w->left) w->left->color = false;
-           if (x_parent) right_rotate(x_parent);
-           x = root;
-           x_parent = nullptr;
-         }
-       }
+   Node *find_node(const Key &key) const { return core::find(root, key, comp); }
+
+   /**
+    * first node whose key is not less than key. It always runs to a leaf,
+    * so it takes one comparison per level and uses the result as the child
+    * index: the loop body compiles to conditional moves.
+    */
+   Node *lower_bound_node(const Key &key) const {
+     Node *cur = root, *res = nullptr;
+     while (cur) {
+       int dir = comp(cur->data.first, key);
+       res = dir ? res : cur;
+       cur = cur->kid(dir);
      }
-     if (x) x->color = false;
+     return res;
+   }
+
+   // the node holding key, or null with parent->child[dir] its free slot
+   Node *descend(const Key &key, Node *&parent, int &dir) const {
+     return core::descend(root, key, comp, parent, dir);
    }
 
    void clear_node(Node *x) {
      if (!x) return;
-     clear_node(x->left);
-     clear_node(x->right);
-     delete x;
+     clear_node(x->kid(0));
+     clear_node(x->kid(1));
+     destroy_node(x);
+   }
+
+   typedef detail::bool_tag<detail::is_raw_payload<value_type>::value> raw_tag;
+
+   // nothing to destroy and nothing to free: dropping the nodes is enough
+   static const bool skip_teardown =
+       detail::skips_deallocate<Alloc>::value && detail::is_raw_payload<value_type>::value;
+
+   // copies the payload of other into p; the links are left to the caller
+   static Node *copy_into(void *p, const Node *other, detail::bool_tag<false>) {
+     return new (p) Node(other->data);
+   }
+   // a raw Node has a trivial copy constructor, so this is one memcpy of
+   // the whole node, done as a real construction
+   static Node *copy_into(void *p, const Node *other, detail::bool_tag<true>) {
+     return new (p) Node(*other);
+   }
+
+   // copies the payload of other into a fresh unlinked node
+   Node *copy_node(const Node *other) {
+     bool pooled;
+     void *p = node_storage(pooled);
+     Node *x;
+     try {
+       x = copy_into(p, other, raw_tag());
+     } catch (...) {
+       release_storage(p, pooled);
+       throw;
+     }
+     x->pooled = pooled;
+     return x;
    }
 
    Node *clone_subtree(Node *parent, Node *other) {
      if (!other) return nullptr;
-     Node *x = new Node(other->data);
+     Node *x = copy_node(other);
      x->color = other->color;
      x->parent = parent;
-     x->left = clone_subtree(x, other->left);
-     x->right = clone_subtree(x, other->right);
+     x->child[0] = clone_subtree(x, other->kid(0));
+     x->child[1] = clone_subtree(x, other->kid(1));
      ++node_count;
      return x;
    }
 
+   // detaches z from the tree and rebalances; z itself is not freed
+   void unlink_node(Node *z) {
+     if (z == leftmost) leftmost = core::next_node(z);
+     if (z == rightmost) rightmost = core::prev_node(z);
+     core::unlink(root, z);
+     --node_count;
+   }
+
+   // a red-black tree over size_t nodes is never deeper than this
+   static const int max_depth = 2 * 8 * sizeof(size_t);
+
+   /**
+    * in-order walk over lo <= key < hi (a null bound is open): one descent
+    * to the first element, then plain successor moves without the
+    * iterator's checks. hi is compared against the key of the node in
+    * hand rather than looked up, as a second descent costs more than the
+    * compares of a short range. Stops as soon as visit returns false and
+    * reports whether it got to the end
+    */
+   template<class Visit>
+   bool walk(const Key *lo, const Key *hi, Visit &visit) const {
+     Node *x = lo ? lower_bound_node(*lo) : leftmost;
+     if (!hi) {
+       for (; x; x = core::next_node(x))
+         if (!visit(x)) return false;
+       return true;
+     }
+     for (; x && comp(x->data.first, *hi); x = core::next_node(x))
+       if (!visit(x)) return false;
+     return true;
+   }
+
+   // frees a list threaded through child[1]
+   void free_list(Node *x) {
+     while (x) {
+       Node *next = x->kid(1);
+       destroy_node(x);
+       x = next;
+     }
+   }
+
+   // relinks a sorted list of n nodes into root; O(n), no allocation
+   void rebuild(Node *head, size_t n) {
+     root = core::build(head, n);
+     node_count = n;
+     reset_extremes();
+   }
+
   public:
    class const_iterator;
    class iterator {
@@ -202,20 +715,8 @@ template<
 
       iterator(map *o, Node *c) : owner(o), cur(c) {}
 
-      static Node *next_node(Node *x) {
-        if (!x) return nullptr;
-        if (x->right) return min_node(x->right);
-        Node *p = x->parent;
-        while (p && x == p->right) { x = p; p = p->parent; }
-        return p;
-      }
-      static Node *prev_node(Node *x) {
-        if (!x) return nullptr;
-        if (x->left) return max_node(x->left);
-        Node *p = x->parent;
-        while (p && x == p->left) { x = p; p = p->parent; }
-        return p;
-      }
+      static Node *next_node(Node *x) { return core::next_node(x); }
+      static Node *prev_node(Node *x) { return core::prev_node(x); }
 
      public:
       iterator() = default;
@@ -242,7 +743,7 @@ template<
         if (!owner) throw invalid_iterator();
         if (!cur) { // --end() => last element if not empty
           if (!owner->root) throw invalid_iterator();
-          cur = max_node(owner->root);
+          cur = owner->rightmost;
           return *this;
         }
         Node *prv = prev_node(cur);
@@ -275,7 +776,7 @@ template<
 
       const_iterator(const map *o, Node *c) : owner(o), cur(c) {}
 
-      static Node *next_node(Node *x) { return iterator::next_node(x); }
+      static Node *next_node(Node *x) { return core::next_node(x); }
       static Node *prev_node(Node *x) { return iterator::prev_node(x); }
 
      public:
@@ -306,7 +807,7 @@ template<
         if (!owner) throw invalid_iterator();
         if (!cur) {
           if (!owner->root) throw invalid_iterator();
-          cur = max_node(owner->root);
+          cur = owner->rightmost;
           return *this;
         }
         Node *prv = prev_node(cur);
@@ -333,8 +834,12 @@ template<
 
    map() = default;
 
-   map(const map &other) : root(nullptr), node_count(0), comp(other.comp) {
+   // nodes come from (a copy of) a; see detail::heap_alloc for the interface
+   explicit map(const Alloc &a) : alloc(a) {}
+
+   map(const map &other) : root(nullptr), node_count(0), comp(other.comp), alloc(other.alloc) {
      root = clone_subtree(nullptr, other.root);
+     reset_extremes();
    }
 
    map &operator=(const map &other) {
@@ -342,10 +847,14 @@ template<
      clear();
      comp = other.comp;
      root = clone_subtree(nullptr, other.root);
+     reset_extremes();
      return *this;
    }
 
-   ~map() { clear(); }
+   ~map() {
+     clear();
+     free_blocks(blocks);
+   }
 
    T &at(const Key &key) {
      Node *x = find_node(key);
@@ -359,27 +868,18 @@ template<
    }
 
    T &operator[](const Key &key) {
-     Node *cur = root, *parent = nullptr;
-     while (cur) {
-       parent = cur;
-       if (comp(key, cur->data.first)) cur = cur->left;
-       else if (comp(cur->data.first, key)) cur = cur->right;
-       else return cur->data.second;
-     }
-     Node *z = new Node(value_type(key, T()));
-     z->parent = parent;
-     if (!parent) root = z;
-     else if (comp(z->data.first, parent->data.first)) parent->left = z;
-     else parent->right = z;
-     ++node_count;
-     insert_fix(z);
+     Node *parent;
+     int dir;
+     if (Node *x = descend(key, parent, dir)) return x->data.second;
+     Node *z = make_node(value_type(key, T()));
+     attach(z, parent, dir);
      return z->data.second;
    }
 
    const T &operator[](const Key &key) const { return at(key); }
 
-   iterator begin() { return iterator(this, min_node(root)); }
-   const_iterator cbegin() const { return const_iterator(this, min_node(root)); }
+   iterator begin() { return iterator(this, leftmost); }
+   const_iterator cbegin() const { return const_iterator(this, leftmost); }
 
    iterator end() { return iterator(this, nullptr); }
    const_iterator cend() const { return const_iterator(this, nullptr); }
@@ -387,77 +887,595 @@ template<
    bool empty() const { return node_count == 0; }
    size_t size() const { return node_count; }
 
+   /**
+    * reserved capacity is kept; shrink_to_fit() gives it back. With a
+    * skip_deallocate allocator and trivial Key and T the nodes are just
+    * dropped in O(1), as is the destructor.
+    */
    void clear() {
-     clear_node(root);
-     root = nullptr;
+     if (!skip_teardown || blocks) clear_node(root);
+     root = leftmost = rightmost = nullptr;
      node_count = 0;
    }
 
-   pair<iterator, bool> insert(const value_type &value) {
-     Node *cur = root, *parent = nullptr;
-     while (cur) {
-       parent = cur;
-       if (comp(value.first, cur->data.first)) cur = cur->left;
-       else if (comp(cur->data.first, value.first)) cur = cur->right;
-       else return pair<iterator, bool>(iterator(this, cur), false);
+   // elements the map can hold before it allocates another node
+   size_t capacity() const { return node_count + spare_count; }
+
+   /**
+    * makes room for n elements in one block, so the next inserts take
+    * adjacent slots instead of allocating node by node
+    */
+   void reserve(size_t n) {
+     if (n <= capacity()) return;
+     size_t slots = n - capacity();
+     node_block *b = new_block(slots);
+     b->next = blocks;
+     blocks = b;
+     Node *slot = block_slots(b);
+     for (size_t i = slots; i-- > 0;) release_storage(slot + i, true);
+   }
+
+   /**
+    * moves the elements into one block of exactly size() slots, in key
+    * order, and frees every other reserved block; does nothing if no
+    * storage is reserved. Invalidates all iterators. If copying an
+    * element throws, the map is left unchanged.
+    */
+   void shrink_to_fit() {
+     if (!blocks || !spare_count) return;
+     if (!node_count) {
+       free_blocks(blocks);
+       blocks = nullptr;
+       spare = nullptr;
+       spare_count = 0;
+       return;
      }
-     Node *z = new Node(value);
-     z->parent = parent;
-     if (!parent) root = z;
-     else if (comp(z->data.first, parent->data.first)) parent->left = z;
-     else parent->right = z;
-     ++node_count;
-     insert_fix(z);
+     node_block *b = new_block(node_count);
+     Node *slot = block_slots(b);
+     Node *head = core::flatten(root, nullptr);
+     size_t done = 0;
+     try {
+       for (Node *x = head; x; x = x->kid(1), ++done) copy_into(slot + done, x, raw_tag());
+     } catch (...) {
+       while (done) slot[--done].~Node();
+       free_blocks(b);
+       rebuild(head, node_count);
+       throw;
+     }
+     for (Node *x = head; x;) {
+       Node *next = x->kid(1);
+       bool pooled = x->pooled;
+       x->~Node();
+       if (!pooled) alloc.deallocate(x, sizeof(Node));
+       x = next;
+     }
+     free_blocks(blocks);
+     blocks = b;
+     spare = nullptr;
+     spare_count = 0;
+     for (size_t i = 0; i < node_count; ++i) {
+       slot[i].pooled = true;
+       slot[i].child[1] = i + 1 < node_count ? slot + i + 1 : nullptr;
+     }
+     rebuild(slot, node_count);
+   }
+
+   pair<iterator, bool> insert(const value_type &value) {
+     Node *parent;
+     int dir;
+     if (Node *x = descend(value.first, parent, dir)) return pair<iterator, bool>(iterator(this, x), false);
+     Node *z = make_node(value);
+     attach(z, parent, dir);
      return pair<iterator, bool>(iterator(this, z), true);
    }
 
    void erase(iterator pos) {
      if (pos.owner != this || pos.cur == nullptr) throw invalid_iterator();
      Node *z = pos.cur;
+     unlink_node(z);
+     destroy_node(z);
+   }
 
-     Node *y = z;
-     bool y_original_color = y->color;
-     Node *x = nullptr; // the node that moves into y's position
-     Node *x_parent = nullptr;
+   /**
+    * one operation of apply_batch(); it refers to the caller's key or
+    * value, which must stay alive until apply_batch() returns
+    */
+   class batch_op {
+      friend class map;
+     private:
+      const Key *key;
+      const value_type *value; // nullptr for erase
 
-     if (!z->left) {
-       x = z->right;
-       x_parent = z->parent;
-       transplant(z, z->right);
-     } else if (!z->right) {
-       x = z->left;
-       x_parent = z->parent;
-       transplant(z, z->left);
-     } else {
-       y = min_node(z->right); // successor
-       y_original_color = y->color;
-       x = y->right;
-       if (y->parent == z) {
-         x_parent = y;
-         if (x) x->parent = y;
+      batch_op(const Key *k, const value_type *v) : key(k), value(v) {}
+
+     public:
+      static batch_op insert(const value_type &v) { return batch_op(&v.first, &v); }
+      static batch_op erase(const Key &k) { return batch_op(&k, nullptr); }
+   };
+
+  private:
+   struct batch_plan {
+     Node *orig;  // node holding the key before the batch
+     Node *succ;  // first node after the key, when orig is null
+     Node *fresh; // node to hold the key after the batch
+     const value_type *value;
+     bool present;
+   };
+
+   // stable bottom-up merge sort of op indices by key
+   void sort_ops(const batch_op *ops, size_t *idx, size_t *tmp, size_t n) const {
+     for (size_t width = 1; width < n; width *= 2) {
+       for (size_t lo = 0; lo < n; lo += 2 * width) {
+         size_t mid = lo + width < n ? lo + width : n;
+         size_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+         size_t i = lo, j = mid, k = lo;
+         while (i < mid && j < hi) {
+           if (comp(*ops[idx[j]].key, *ops[idx[i]].key)) tmp[k++] = idx[j++];
+           else tmp[k++] = idx[i++];
+         }
+         while (i < mid) tmp[k++] = idx[i++];
+         while (j < hi) tmp[k++] = idx[j++];
+       }
+       for (size_t i = 0; i < n; ++i) idx[i] = tmp[i];
+     }
+   }
+
+   // fills plans from sorted ops and returns how many there are; may throw
+   // only from comp, before anything has been modified
+   size_t plan_batch(const batch_op *ops, const size_t *idx, size_t n,
+                     batch_plan *plans, bool walk) const {
+     size_t m = 0;
+     Node *x = walk ? leftmost : nullptr;
+     for (size_t i = 0; i < n;) {
+       const Key &key = *ops[idx[i]].key;
+       batch_plan &p = plans[m++];
+       if (walk) {
+         while (x && comp(x->data.first, key)) x = core::next_node(x);
+         p.orig = x && !comp(key, x->data.first) ? x : nullptr;
        } else {
-         x_parent = y->parent;
-         transplant(y, y->right);
-         y->right = z->right;
-         if (y->right) y->right->parent = y;
+         p.orig = find_node(key);
+         if (!p.orig) {
+           Node *cur = root;
+           x = nullptr;
+           while (cur) {
+             int dir = !comp(key, cur->data.first);
+             x = dir ? x : cur;
+             cur = cur->kid(dir);
+           }
+         }
        }
-       transplant(z, y);
-       y->left = z->left;
-       if (y->left) y->left->parent = y;
-       y->color = z->color;
+       p.succ = p.orig ? nullptr : x;
+       p.fresh = nullptr;
+       p.value = nullptr;
+       p.present = p.orig != nullptr;
+       // replay the ops on this key in their original order
+       for (; i < n && !comp(key, *ops[idx[i]].key); ++i) {
+         const batch_op &op = ops[idx[i]];
+         if (op.value) {
+           if (!p.present) {
+             p.present = true;
+             p.value = op.value;
+           }
+         } else if (p.present) {
+           p.present = false;
+           p.value = nullptr;
+         }
+       }
+     }
+     return m;
+   }
+
+   // rebuilds the whole tree while merging in the plans; no comparisons
+   void merge_batch(const batch_plan *plans, size_t m) {
+     Node *x = core::flatten(root, nullptr);
+     detail::rb_node_base *head = nullptr, **link = &head;
+     size_t n = 0, j = 0;
+     while (x || j < m) {
+       Node *y = nullptr, *next = x;
+       if (j < m && (plans[j].orig ? plans[j].orig == x : plans[j].succ == x)) {
+         const batch_plan &p = plans[j++];
+         if (p.orig) next = x->kid(1);
+         if (p.present) y = p.fresh ? p.fresh : p.orig;
+       } else {
+         y = x;
+         next = x->kid(1);
+       }
+       if (y) {
+         *link = y;
+         link = &y->child[1];
+         ++n;
+       }
+       x = next;
+     }
+     *link = nullptr;
+     rebuild(core::cast(head), n);
+   }
+
+  public:
+   /**
+    * applies a batch of inserts and erases as if one after another in the
+    * given order. Ops are sorted by key and every new node is constructed
+    * up front, so if a constructor (or comp) throws the map is left
+    * untouched. Large batches are merged with the tree in one in-order
+    * pass followed by a balanced rebuild; small ones are linked in place.
+    */
+   void apply_batch(const batch_op *ops, size_t n) {
+     if (n == 0) return;
+     size_t *idx = new size_t[n], *tmp = nullptr;
+     batch_plan *plans = nullptr;
+     size_t m = 0;
+     bool walk = false;
+     try {
+       tmp = new size_t[n];
+       for (size_t i = 0; i < n; ++i) idx[i] = i;
+       sort_ops(ops, idx, tmp, n);
+       plans = new batch_plan[n];
+       size_t depth = 1;
+       while ((size_t(1) << depth) <= node_count) ++depth;
+       walk = n * depth >= node_count;
+       m = plan_batch(ops, idx, n, plans, walk);
+       for (size_t i = 0; i < m; ++i)
+         if (plans[i].value) plans[i].fresh = make_node(*plans[i].value);
+     } catch (...) {
+       for (size_t i = 0; i < m; ++i)
+         if (plans[i].fresh) destroy_node(plans[i].fresh);
+       delete[] plans;
+       delete[] tmp;
+       delete[] idx;
+       throw;
+     }
+
+     if (walk) {
+       merge_batch(plans, m);
+     } else {
+       for (size_t i = 0; i < m; ++i) {
+         if (plans[i].orig || !plans[i].fresh) continue;
+         core::link_before(root, plans[i].fresh, plans[i].succ);
+         ++node_count;
+       }
+       for (size_t i = 0; i < m; ++i) {
+         if (!plans[i].orig) continue;
+         if (plans[i].fresh) core::replace(root, plans[i].orig, plans[i].fresh);
+         else if (!plans[i].present) unlink_node(plans[i].orig);
+       }
+       reset_extremes();
      }
+     for (size_t i = 0; i < m; ++i)
+       if (plans[i].orig && (plans[i].fresh || !plans[i].present)) destroy_node(plans[i].orig);
+     delete[] plans;
+     delete[] tmp;
+     delete[] idx;
+   }
+
+   /**
+    * moves every element whose key is not less than `key` into `upper`
+    * (cleared first). Nodes are relinked rather than copied: each node on
+    * the search path is joined by black height with the side subtree it
+    * keeps, bottom up, which takes O(log n) relinking in all. Finding the
+    * new sizes is what costs more: the smaller part is counted by walking
+    * in from both ends, O(min(k, size() - k)) for k elements below `key`,
+    * because size() is kept in O(1) without per-node subtree counts.
+    * Iterators to moved elements are invalidated. Throws runtime_error
+    * unless the allocators are equal and neither map holds storage from
+    * reserve(); if comp throws, neither map changes.
+    */
+   void split(const Key &key, map &upper) {
+     if (&upper == this || !(alloc == upper.alloc) || blocks || upper.blocks) throw runtime_error();
+     Node *path[max_depth];
+     size_t height[max_depth]; // black height of path[i]
+     bool goes_up[max_depth];  // path[i] belongs in upper
+     int top = 0;
+     Node *first_up = nullptr;
+     size_t h = core::black_height(root);
+     for (Node *x = root; x; ++top) {
+       path[top] = x;
+       height[top] = h;
+       goes_up[top] = !comp(x->data.first, key);
+       if (goes_up[top]) first_up = x;
+       if (!x->color) --h;
+       x = x->kid(!goes_up[top]);
+     }
+     upper.clear();
+     size_t lower_n = node_count;
+     if (first_up) {
+       Node *a = leftmost, *b = rightmost;
+       for (size_t lo = 0, hi = 0;; ++lo, ++hi) {
+         if (a == first_up) { lower_n = lo; break; }
+         if (b == first_up) { lower_n = node_count - hi - 1; break; }
+         a = core::next_node(a);
+         b = core::prev_node(b);
+       }
+     }
+     Node *lower = nullptr, *higher = nullptr;
+     size_t lower_h = 0, higher_h = 0;
+     while (top--) {
+       Node *x = path[top];
+       size_t below = height[top] - !x->color;
+       if (goes_up[top]) higher = core::join(higher, higher_h, x, x->kid(1), below, higher_h);
+       else lower = core::join(x->kid(0), below, x, lower, lower_h, lower_h);
+     }
+     upper.root = higher;
+     upper.node_count = node_count - lower_n;
+     upper.reset_extremes();
+     root = lower;
+     node_count = lower_n;
+     reset_extremes();
+   }
+
+   /**
+    * moves every element of `upper` into this map; all keys of `upper`
+    * must be greater than all keys here, the allocators equal and neither
+    * map hold storage from reserve(), otherwise runtime_error is thrown
+    * and neither map changes. The minimum of `upper` is unlinked and used
+    * to join the two trees by black height: O(log(size() + upper.size())).
+    */
+   void join(map &upper) {
+     if (&upper == this || !(alloc == upper.alloc) || blocks || upper.blocks) throw runtime_error();
+     if (!upper.root) return;
+     if (root && !comp(rightmost->data.first, upper.leftmost->data.first))
+       throw runtime_error();
+     Node *k = upper.leftmost;
+     core::unlink_extreme(upper.root, k, 0);
+     size_t h;
+     root = core::join(root, core::black_height(root), k, upper.root, core::black_height(upper.root), h);
+     if (!leftmost) leftmost = k;
+     rightmost = upper.rightmost;
+     node_count += upper.node_count;
+     upper.root = upper.leftmost = upper.rightmost = nullptr;
+     upper.node_count = 0;
+   }
+
+   /**
+    * erases every element for which pred(value_type &) is true in one
+    * O(n) pass: the survivors are relinked into a balanced tree instead
+    * of running an erase fixup per element. Returns how many went;
+    * iterators to them are invalidated. If pred throws, the elements
+    * already removed stay removed and the map is valid.
+    */
+   template<class Pred>
+   size_t remove_if(Pred pred) {
+     Node *x = core::flatten(root, nullptr);
+     detail::rb_node_base *head = nullptr, **link = &head;
+     size_t kept = 0, seen = 0, total = node_count;
+     try {
+       for (; x; ++seen) {
+         Node *next = x->kid(1);
+         if (pred(x->data)) {
+           destroy_node(x);
+         } else {
+           *link = x;
+           link = &x->child[1];
+           ++kept;
+         }
+         x = next;
+       }
+     } catch (...) {
+       *link = x;
+       rebuild(core::cast(head), kept + (total - seen));
+       throw;
+     }
+     *link = nullptr;
+     rebuild(core::cast(head), kept);
+     return total - kept;
+   }
+
+   /**
+    * double-ended priority queue access. The extreme nodes are cached, so
+    * peeking is O(1) and popping skips the descent; an extreme node has at
+    * most one (red leaf) child, so most pops need no erase fixup at all.
+    * All throw container_is_empty on an empty map.
+    */
+   value_type &peek_min() {
+     if (!leftmost) throw container_is_empty();
+     return leftmost->data;
+   }
+   const value_type &peek_min() const {
+     if (!leftmost) throw container_is_empty();
+     return leftmost->data;
+   }
+   value_type &peek_max() {
+     if (!rightmost) throw container_is_empty();
+     return rightmost->data;
+   }
+   const value_type &peek_max() const {
+     if (!rightmost) throw container_is_empty();
+     return rightmost->data;
+   }
 
-     delete z;
+   void pop_min() {
+     Node *z = leftmost;
+     if (!z) throw container_is_empty();
+     leftmost = z->kid(1) ? z->kid(1) : z->up();
+     if (z == rightmost) rightmost = nullptr;
+     core::unlink_extreme(root, z, 0);
      --node_count;
+     destroy_node(z);
+   }
 
-     if (!y_original_color) erase_fix(x, x_parent);
-     if (root) root->color = false;
+   void pop_max() {
+     Node *z = rightmost;
+     if (!z) throw container_is_empty();
+     rightmost = z->kid(0) ? z->kid(0) : z->up();
+     if (z == leftmost) leftmost = nullptr;
+     core::unlink_extreme(root, z, 1);
+     --node_count;
+     destroy_node(z);
+   }
+
+   /**
+    * calls fn(value_type &) on every element with lo <= key < hi, in key
+    * order, without going through iterators. fn must not insert or erase.
+    */
+   template<class F>
+   void for_each(const Key &lo, const Key &hi, F fn) {
+     auto visit = [&fn](Node *x) { fn(x->data); return true; };
+     walk(&lo, &hi, visit);
+   }
+   template<class F>
+   void for_each(const Key &lo, const Key &hi, F fn) const {
+     auto visit = [&fn](Node *x) { fn(static_cast<const value_type &>(x->data)); return true; };
+     walk(&lo, &hi, visit);
+   }
+   template<class F>
+   void for_each(F fn) {
+     auto visit = [&fn](Node *x) { fn(x->data); return true; };
+     walk(nullptr, nullptr, visit);
+   }
+   template<class F>
+   void for_each(F fn) const {
+     auto visit = [&fn](Node *x) { fn(static_cast<const value_type &>(x->data)); return true; };
+     walk(nullptr, nullptr, visit);
+   }
+
+   /**
+    * like for_each(lo, hi, fn) but stops at the first element for which
+    * fn returns false; returns true if the whole range was visited
+    */
+   template<class F>
+   bool for_each_while(const Key &lo, const Key &hi, F fn) {
+     auto visit = [&fn](Node *x) { return static_cast<bool>(fn(x->data)); };
+     return walk(&lo, &hi, visit);
+   }
+   template<class F>
+   bool for_each_while(const Key &lo, const Key &hi, F fn) const {
+     auto visit = [&fn](Node *x) { return static_cast<bool>(fn(static_cast<const value_type &>(x->data))); };
+     return walk(&lo, &hi, visit);
+   }
+
+   /**
+    * resumable position of a bulk export. It stays valid as long as
+    * neither its next element nor its end bound is erased.
+    */
+   class export_cursor {
+      friend class map;
+     private:
+      const map *owner = nullptr;
+      Node *next = nullptr, *stop = nullptr;
+
+      export_cursor(const map *o, Node *n, Node *s) : owner(o), next(n), stop(s) {}
+
+     public:
+      export_cursor() = default;
+      bool done() const { return next == stop; }
+   };
+
+   // cursor over lo <= key < hi
+   export_cursor export_begin(const Key &lo, const Key &hi) const {
+     Node *first = lower_bound_node(lo);
+     Node *stop = lower_bound_node(hi);
+     if (!first || (stop && !comp(first->data.first, stop->data.first))) first = stop;
+     return export_cursor(this, first, stop);
+   }
+   export_cursor export_begin() const { return export_cursor(this, leftmost, nullptr); }
+
+   /**
+    * copies up to max of the next elements of the cursor into the parallel
+    * arrays key_out[] and value_out[] (either may be null to skip that
+    * column) and advances the cursor; returns how many were written.
+    * The arrays are assigned to, so they must hold constructed objects.
+    */
+   size_t export_range(export_cursor &cursor, Key *key_out, T *value_out, size_t max) const {
+     if (cursor.owner != this) throw invalid_iterator();
+     size_t n = 0;
+     Node *x = cursor.next;
+     for (; n < max && x != cursor.stop; ++n, x = core::next_node(x)) {
+       if (key_out) key_out[n] = x->data.first;
+       if (value_out) value_out[n] = x->data.second;
+     }
+     cursor.next = x;
+     return n;
+   }
+
+   // first chunk of lo <= key < hi; use a cursor to continue past max
+   size_t export_range(const Key &lo, const Key &hi, Key *key_out, T *value_out, size_t max) const {
+     export_cursor cursor = export_begin(lo, hi);
+     return export_range(cursor, key_out, value_out, max);
+   }
+
+   /**
+    * snapshot layout: three size_t (snapshot_magic, sizeof(value_type),
+    * element count), then the raw value_type records in key order. Records
+    * go through a stack buffer snapshot_block bytes at a time.
+    */
+   static const size_t snapshot_block = 4096;
+   static const size_t snapshot_magic = 0x736a7475; // "sjtu"
+
+   /**
+    * writes every element to out as raw bytes, in key order and a block
+    * at a time; only for trivially copyable Key and T. Throws
+    * runtime_error on a short write.
+    */
+   void write_snapshot(std::FILE *out) const {
+     static_assert(detail::is_raw_payload<value_type>::value,
+                   "write_snapshot needs trivially copyable Key and T");
+     size_t header[3] = {snapshot_magic, sizeof(value_type), node_count};
+     if (std::fwrite(header, sizeof(header), 1, out) != 1) throw runtime_error();
+     const size_t per_block = snapshot_block / sizeof(value_type) ? snapshot_block / sizeof(value_type) : 1;
+     alignas(value_type) unsigned char buf[per_block * sizeof(value_type)];
+     size_t n = 0;
+     for (Node *x = leftmost; x; x = core::next_node(x)) {
+       std::memcpy(buf + n * sizeof(value_type), static_cast<const void *>(&x->data), sizeof(value_type));
+       if (++n == per_block) {
+         if (std::fwrite(buf, sizeof(value_type), n, out) != n) throw runtime_error();
+         n = 0;
+       }
+     }
+     if (n && std::fwrite(buf, sizeof(value_type), n, out) != n) throw runtime_error();
+   }
+
+   /**
+    * replaces the contents with a snapshot written by write_snapshot and
+    * builds a balanced tree in O(n) without comparisons beyond an order
+    * check. On a bad header, short read or unsorted records it throws
+    * runtime_error and leaves the map unchanged.
+    */
+   void read_snapshot(std::FILE *in) {
+     static_assert(detail::is_raw_payload<value_type>::value,
+                   "read_snapshot needs trivially copyable Key and T");
+     size_t header[3];
+     if (std::fread(header, sizeof(header), 1, in) != 1 || header[0] != snapshot_magic ||
+         header[1] != sizeof(value_type))
+       throw runtime_error();
+     const size_t per_block = snapshot_block / sizeof(value_type) ? snapshot_block / sizeof(value_type) : 1;
+     alignas(value_type) unsigned char buf[per_block * sizeof(value_type)];
+     Node *head = nullptr, *tail = nullptr;
+     try {
+       for (size_t left = header[2]; left;) {
+         size_t n = left < per_block ? left : per_block;
+         if (std::fread(buf, sizeof(value_type), n, in) != n) throw runtime_error();
+         for (size_t i = 0; i < n; ++i) {
+           // each record is the bytes of a trivially copyable value_type;
+           // the node is constructed from it, not copied over raw storage
+           const value_type &rec = *reinterpret_cast<const value_type *>(buf + i * sizeof(value_type));
+           bool pooled;
+           Node *x = new (node_storage(pooled)) Node(rec); // cannot throw
+           x->pooled = pooled;
+           if (tail && !comp(tail->data.first, x->data.first)) {
+             destroy_node(x);
+             throw runtime_error();
+           }
+           if (tail) tail->child[1] = x;
+           else head = x;
+           tail = x;
+         }
+         left -= n;
+       }
+     } catch (...) {
+       free_list(head);
+       throw;
+     }
+     clear();
+     rebuild(head, header[2]);
    }
 
    size_t count(const Key &key) const { return find_node(key) ? 1 : 0; }
 
    iterator find(const Key &key) { return iterator(this, find_node(key)); }
    const_iterator find(const Key &key) const { return const_iterator(this, find_node(key)); }
+
+   // first element whose key is not less than key, or end()
+   iterator lower_bound(const Key &key) { return iterator(this, lower_bound_node(key)); }
+   const_iterator lower_bound(const Key &key) const { return const_iterator(this, lower_bound_node(key)); }
 };
 
 }
@@ -0,0 +1,113 @@
+/**
+* bump allocator for short-lived maps
+*/
+#ifndef SJTU_MONOTONIC_ARENA_HPP
+#define SJTU_MONOTONIC_ARENA_HPP
+
+#include <cstddef>
+
+namespace sjtu {
+
+/**
+ * hands out memory by bumping a pointer through chunks that double in
+ * size, and never frees individual blocks: everything goes at once in
+ * reset() or the destructor. Not thread-safe.
+ */
+class monotonic_arena {
+  private:
+   static const size_t align = alignof(long double) > alignof(void *) ? alignof(long double) : alignof(void *);
+   static const size_t max_chunk = size_t(1) << 24;
+
+   struct chunk {
+     chunk *next;
+     size_t bytes;
+   };
+   static const size_t header = (sizeof(chunk) + align - 1) / align * align;
+
+   chunk *chunks = nullptr;
+   char *cur = nullptr, *limit = nullptr;
+   size_t next_chunk;
+   size_t in_use = 0;
+
+   void grow(size_t bytes) {
+     size_t size = next_chunk;
+     while (size < bytes + header) size *= 2;
+     chunk *c = static_cast<chunk *>(::operator new(size));
+     c->next = chunks;
+     c->bytes = size;
+     chunks = c;
+     cur = reinterpret_cast<char *>(c) + header;
+     limit = reinterpret_cast<char *>(c) + size;
+     if (next_chunk < max_chunk) next_chunk *= 2;
+   }
+
+  public:
+   explicit monotonic_arena(size_t initial_bytes = 4096) : next_chunk(initial_bytes < 256 ? 256 : initial_bytes) {}
+   monotonic_arena(const monotonic_arena &) = delete;
+   monotonic_arena &operator=(const monotonic_arena &) = delete;
+   ~monotonic_arena() { release(); }
+
+   void *allocate(size_t bytes) {
+     bytes = (bytes + align - 1) / align * align;
+     if (static_cast<size_t>(limit - cur) < bytes) grow(bytes);
+     void *p = cur;
+     cur += bytes;
+     in_use += bytes;
+     return p;
+   }
+
+   /**
+    * frees every block at once but keeps the newest (largest) chunk for
+    * the next round. Every map using the arena must be gone or cleared.
+    */
+   void reset() {
+     if (!chunks) return;
+     chunk *keep = chunks;
+     chunks = keep->next;
+     release();
+     keep->next = nullptr;
+     chunks = keep;
+     cur = reinterpret_cast<char *>(keep) + header;
+     limit = reinterpret_cast<char *>(keep) + keep->bytes;
+   }
+
+   // returns every chunk to the heap
+   void release() {
+     while (chunks) {
+       chunk *next = chunks->next;
+       ::operator delete(chunks);
+       chunks = next;
+     }
+     cur = limit = nullptr;
+     in_use = 0;
+   }
+
+   size_t used() const { return in_use; }
+};
+
+/**
+ * Alloc policy for sjtu::map that draws nodes from a monotonic_arena it
+ * does not own. deallocate() is a no-op and skip_deallocate tells the map
+ * so: with trivially copyable Key and T, clear() and the destructor drop
+ * the whole tree in O(1). Handles on the same arena compare equal.
+ *
+ *   sjtu::monotonic_arena arena;
+ *   sjtu::map<int, int, std::less<int>, sjtu::arena_alloc> scratch{sjtu::arena_alloc(arena)};
+ */
+class arena_alloc {
+  private:
+   monotonic_arena *arena;
+
+  public:
+   static const bool skip_deallocate = true;
+
+   explicit arena_alloc(monotonic_arena &a) : arena(&a) {}
+
+   void *allocate(size_t bytes) { return arena->allocate(bytes); }
+   void deallocate(void *, size_t) {}
+   bool operator==(const arena_alloc &other) const { return arena == other.arena; }
+};
+
+}
+
+#endif
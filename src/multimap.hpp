@@ -0,0 +1,289 @@
+/**
+* implement a container like std::multimap
+*/
+#ifndef SJTU_MULTIMAP_HPP
+#define SJTU_MULTIMAP_HPP
+
+#include <cstddef>
+#include <new>
+#include "map.hpp"
+
+namespace sjtu {
+
+/**
+ * equal keys share one map node whose mapped value is a run of all their
+ * values in insertion order. The first value is stored inline in the node,
+ * so a key with a single value costs no allocation beyond the node; more
+ * values spill into a doubly linked list of chunks of growing capacity.
+ * count() and equal_range() are O(log n).
+ */
+template<
+   class Key,
+   class T,
+   class Compare = std::less<Key>
+   > class multimap {
+  public:
+   typedef pair<const Key, T> value_type;
+
+  private:
+   struct chunk {
+     chunk *prev, *next;
+     size_t used, cap;
+
+     static size_t header() { return (sizeof(chunk) + alignof(T) - 1) / alignof(T) * alignof(T); }
+     T *items() { return reinterpret_cast<T *>(reinterpret_cast<char *>(this) + header()); }
+     const T *items() const { return reinterpret_cast<const T *>(reinterpret_cast<const char *>(this) + header()); }
+
+     static chunk *create(size_t cap) {
+       chunk *c = static_cast<chunk *>(::operator new(header() + cap * sizeof(T)));
+       c->prev = c->next = nullptr;
+       c->used = 0;
+       c->cap = cap;
+       return c;
+     }
+   };
+
+   static const size_t first_chunk = 3, max_chunk = 256;
+
+   class value_run {
+      alignas(T) unsigned char first_buf[sizeof(T)];
+      size_t n = 0;
+      chunk *head = nullptr, *tail = nullptr;
+
+     public:
+      value_run() = default;
+      // one pass: the inline value, then each chunk in order
+      value_run(const value_run &other) {
+        try {
+          if (other.n) push_back(*reinterpret_cast<const T *>(other.first_buf));
+          for (const chunk *c = other.head; c; c = c->next)
+            for (size_t i = 0; i < c->used; ++i) push_back(c->items()[i]);
+        } catch (...) {
+          release();
+          throw;
+        }
+      }
+      value_run &operator=(const value_run &) = delete;
+      ~value_run() { release(); }
+
+      size_t size() const { return n; }
+      T *first() { return reinterpret_cast<T *>(first_buf); }
+      chunk *chunks() const { return head; }
+      chunk *last_chunk() const { return tail; }
+
+      void push_back(const T &value) {
+        if (n == 0) {
+          new (first_buf) T(value);
+          ++n;
+          return;
+        }
+        if (!tail || tail->used == tail->cap) {
+          size_t cap = tail ? tail->cap * 2 : first_chunk;
+          if (cap > max_chunk) cap = max_chunk;
+          chunk *c = chunk::create(cap);
+          try {
+            new (c->items()) T(value);
+          } catch (...) {
+            ::operator delete(c);
+            throw;
+          }
+          c->used = 1;
+          c->prev = tail;
+          if (tail) tail->next = c;
+          else head = c;
+          tail = c;
+        } else {
+          new (tail->items() + tail->used) T(value);
+          ++tail->used;
+        }
+        ++n;
+      }
+
+      /**
+       * removes the value at (c, pos), c == nullptr meaning the inline
+       * slot; later values move one place forward
+       */
+      void erase(chunk *c, size_t pos) {
+        T *hole = c ? c->items() + pos : first();
+        hole->~T();
+        for (;;) {
+          T *src;
+          chunk *sc = c;
+          size_t sp = pos + 1;
+          if (!c) {
+            sc = head;
+            sp = 0;
+          } else if (sp == c->used) {
+            sc = c->next;
+            sp = 0;
+          }
+          if (!sc) break;
+          src = sc->items() + sp;
+          new (hole) T(static_cast<T &&>(*src));
+          src->~T();
+          hole = src;
+          c = sc;
+          pos = sp;
+        }
+        --n;
+        if (tail && --tail->used == 0) {
+          chunk *dead = tail;
+          tail = tail->prev;
+          if (tail) tail->next = nullptr;
+          else head = nullptr;
+          ::operator delete(dead);
+        }
+      }
+
+      void release() {
+        if (n) first()->~T();
+        for (chunk *c = head; c;) {
+          chunk *next = c->next;
+          for (size_t i = 0; i < c->used; ++i) c->items()[i].~T();
+          ::operator delete(c);
+          c = next;
+        }
+        n = 0;
+        head = tail = nullptr;
+      }
+   };
+
+   typedef map<Key, value_run, Compare> index_type;
+
+   index_type index;
+   size_t elem_count = 0;
+
+  public:
+   class iterator {
+      friend class multimap;
+     private:
+      typename index_type::iterator it;
+      chunk *c = nullptr; // nullptr: the inline first value
+      size_t pos = 0;
+
+      iterator(typename index_type::iterator i, chunk *ch, size_t p) : it(i), c(ch), pos(p) {}
+
+     public:
+      iterator() = default;
+
+      const Key &key() const { return it->first; }
+      T &value() const { return c ? c->items()[pos] : *it->second.first(); }
+
+      iterator &operator++() {
+        if (!c) c = it->second.chunks();
+        else if (++pos == c->used) c = c->next, pos = 0;
+        else return *this;
+        if (!c) {
+          ++it;
+          pos = 0;
+        }
+        return *this;
+      }
+      iterator operator++(int) {
+        iterator tmp = *this;
+        ++*this;
+        return tmp;
+      }
+      iterator &operator--() {
+        if (c && pos) {
+          --pos;
+        } else if (c && c->prev) {
+          c = c->prev;
+          pos = c->used - 1;
+        } else if (c) {
+          c = nullptr;
+        } else {
+          --it;
+          c = it->second.last_chunk();
+          pos = c ? c->used - 1 : 0;
+        }
+        return *this;
+      }
+      iterator operator--(int) {
+        iterator tmp = *this;
+        --*this;
+        return tmp;
+      }
+
+      bool operator==(const iterator &rhs) const { return it == rhs.it && c == rhs.c && pos == rhs.pos; }
+      bool operator!=(const iterator &rhs) const { return !(*this == rhs); }
+   };
+
+   multimap() = default;
+   multimap(const multimap &other) : index(other.index), elem_count(other.elem_count) {}
+   multimap &operator=(const multimap &other) {
+     if (this == &other) return *this;
+     index = other.index;
+     elem_count = other.elem_count;
+     return *this;
+   }
+
+   size_t size() const { return elem_count; }
+   bool empty() const { return elem_count == 0; }
+   size_t key_count() const { return index.size(); }
+
+   void clear() {
+     index.clear();
+     elem_count = 0;
+   }
+
+   iterator begin() { return iterator(index.begin(), nullptr, 0); }
+   iterator end() { return iterator(index.end(), nullptr, 0); }
+
+   // appends value after every existing value with the same key
+   iterator insert(const value_type &value) {
+     typename index_type::iterator it = index.find(value.first);
+     bool fresh = it == index.end();
+     if (fresh) it = index.insert(pair<const Key, value_run>(value.first, value_run())).first;
+     try {
+       it->second.push_back(value.second);
+     } catch (...) {
+       if (fresh) index.erase(it);
+       throw;
+     }
+     ++elem_count;
+     chunk *c = it->second.last_chunk();
+     return iterator(it, c, c ? c->used - 1 : 0);
+   }
+
+   size_t count(const Key &key) const {
+     typename index_type::const_iterator it = index.find(key);
+     return it == index.cend() ? 0 : it->second.size();
+   }
+
+   // first value of key in insertion order, or end()
+   iterator find(const Key &key) { return iterator(index.find(key), nullptr, 0); }
+
+   pair<iterator, iterator> equal_range(const Key &key) {
+     typename index_type::iterator it = index.find(key);
+     if (it == index.end()) return pair<iterator, iterator>(end(), end());
+     typename index_type::iterator next = it;
+     ++next;
+     return pair<iterator, iterator>(iterator(it, nullptr, 0), iterator(next, nullptr, 0));
+   }
+
+   // removes every value of key; returns how many
+   size_t erase(const Key &key) {
+     typename index_type::iterator it = index.find(key);
+     if (it == index.end()) return 0;
+     size_t n = it->second.size();
+     index.erase(it);
+     elem_count -= n;
+     return n;
+   }
+
+   /**
+    * removes one value; iterators to later values of the same key are
+    * invalidated since those values move forward
+    */
+   void erase(iterator pos) {
+     if (pos.it == index.end()) throw invalid_iterator();
+     if (pos.it->second.size() == 1) index.erase(pos.it);
+     else pos.it->second.erase(pos.c, pos.pos);
+     --elem_count;
+   }
+};
+
+}
+
+#endif
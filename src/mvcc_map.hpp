@@ -0,0 +1,264 @@
+/**
+* multi-version map with snapshot reads
+*/
+#ifndef SJTU_MVCC_MAP_HPP
+#define SJTU_MVCC_MAP_HPP
+
+#include <cstddef>
+#include "map.hpp"
+
+namespace sjtu {
+
+/**
+ * every key keeps a chain of versions, newest first, each tagged with the
+ * timestamp of the write that created it. A snapshot taken at timestamp t
+ * sees, for every key, the newest version with ts <= t, so scans over a
+ * snapshot stay consistent while writers keep going. Versions that no live
+ * snapshot can reach any more are reclaimed by gc().
+ *
+ * There is no locking: "writers keep going" means writes interleaved with
+ * reads of a view on the same thread (or under the caller's own lock),
+ * not concurrent threads. What a view saves is the copy: a consistent
+ * scan of a plain map has to copy it first, which costs about six times
+ * the scan itself; a view costs one chain check per key instead.
+ */
+template<
+   class Key,
+   class T,
+   class Compare = std::less<Key>
+   > class mvcc_map {
+  public:
+   typedef pair<const Key, T> value_type;
+   class read_view;
+
+  private:
+   struct version {
+     size_t ts;
+     version *older;
+     bool erased;
+     version(size_t t, version *o, bool e) : ts(t), older(o), erased(e) {}
+   };
+   struct value_version : version {
+     T value;
+     value_version(size_t t, version *o, const T &v) : version(t, o, false), value(v) {}
+   };
+
+   typedef map<Key, version *, Compare> index_type;
+
+   index_type index;
+   size_t clock = 0;
+   size_t live_count = 0;
+   size_t version_total = 0;
+   size_t gc_threshold = 64;
+   // live snapshots, ordered by ts; horizon() relies on the order
+   read_view *oldest = nullptr, *newest = nullptr;
+
+   static void free_version(version *v) {
+     if (v->erased) delete v;
+     else delete static_cast<value_version *>(v);
+   }
+
+   static const T *value_of(version *v) {
+     return v && !v->erased ? &static_cast<value_version *>(v)->value : nullptr;
+   }
+
+   // newest version visible at ts, or nullptr
+   static version *visible(version *v, size_t ts) {
+     while (v && v->ts > ts) v = v->older;
+     return v;
+   }
+
+   size_t horizon() const { return oldest ? oldest->ts : clock; }
+
+   // frees the versions of one chain that no snapshot can reach;
+   // returns false if nothing of the entry is left
+   bool trim(version *head, size_t h) {
+     version *prev = nullptr, *v = head;
+     while (v && v->ts > h) {
+       prev = v;
+       v = v->older;
+     }
+     if (!v) return true;
+     // v is what the oldest snapshot sees: everything older is unreachable,
+     // and so is v itself when it records an erase
+     bool alive = prev || !v->erased;
+     version *dead = v->older;
+     if (v->erased) {
+       dead = v;
+       if (prev) prev->older = nullptr;
+     } else {
+       v->older = nullptr;
+     }
+     while (dead) {
+       version *o = dead->older;
+       free_version(dead);
+       --version_total;
+       dead = o;
+     }
+     return alive;
+   }
+
+   void push(typename index_type::iterator it, version *v) {
+     it->second = v;
+     ++version_total;
+     if (!trim(v, horizon())) index.erase(it);
+     if (version_total > gc_threshold) gc();
+   }
+
+   // a new snapshot has the largest ts so far
+   void link(read_view *s) {
+     s->prev = newest;
+     s->next = nullptr;
+     if (newest) newest->next = s;
+     else oldest = s;
+     newest = s;
+   }
+
+   // a copy goes next to its original, which has the same ts
+   void link_after(read_view *s, read_view *at) {
+     s->prev = at;
+     s->next = at->next;
+     if (at->next) at->next->prev = s;
+     else newest = s;
+     at->next = s;
+   }
+
+   void unlink(read_view *s) {
+     if (s->prev) s->prev->next = s->next;
+     else oldest = s->next;
+     if (s->next) s->next->prev = s->prev;
+     else newest = s->prev;
+   }
+
+  public:
+   /**
+    * read view at a fixed timestamp. Holding it pins the versions it can
+    * see; it must not outlive its map.
+    */
+   class read_view {
+      friend class mvcc_map;
+     private:
+      mvcc_map *owner;
+      size_t ts;
+      read_view *prev = nullptr, *next = nullptr;
+
+      read_view(mvcc_map *o, size_t t) : owner(o), ts(t) { owner->link(this); }
+
+     public:
+      read_view(const read_view &other) : owner(other.owner), ts(other.ts) {
+        owner->link_after(this, const_cast<read_view *>(&other));
+      }
+      read_view &operator=(const read_view &) = delete;
+      ~read_view() { owner->unlink(this); }
+
+      size_t timestamp() const { return ts; }
+
+      const T *find(const Key &key) const {
+        typename index_type::const_iterator it =
+            static_cast<const index_type &>(owner->index).find(key);
+        if (it == owner->index.cend()) return nullptr;
+        return value_of(visible(it->second, ts));
+      }
+
+      size_t count(const Key &key) const { return find(key) ? 1 : 0; }
+
+      // calls fn(key, value) for every element visible here, in key order
+      template<class F>
+      void for_each(F fn) const {
+        const index_type &idx = owner->index;
+        for (typename index_type::const_iterator it = idx.cbegin(); it != idx.cend(); ++it) {
+          const T *v = value_of(visible(it->second, ts));
+          if (v) fn(it->first, *v);
+        }
+      }
+   };
+
+   mvcc_map() = default;
+   mvcc_map(const mvcc_map &) = delete;
+   mvcc_map &operator=(const mvcc_map &) = delete;
+
+   ~mvcc_map() {
+     for (typename index_type::iterator it = index.begin(); it != index.end(); ++it) {
+       for (version *v = it->second; v;) {
+         version *o = v->older;
+         free_version(v);
+         v = o;
+       }
+     }
+   }
+
+   size_t size() const { return live_count; }
+   bool empty() const { return live_count == 0; }
+   size_t timestamp() const { return clock; }
+   size_t version_count() const { return version_total; }
+
+   read_view snapshot() { return read_view(this, clock); }
+
+   // latest committed value
+   const T *find(const Key &key) const {
+     typename index_type::const_iterator it = index.find(key);
+     return it == index.cend() ? nullptr : value_of(it->second);
+   }
+
+   size_t count(const Key &key) const { return find(key) ? 1 : 0; }
+
+   // inserts or overwrites key as a new version
+   void put(const Key &key, const T &value) {
+     typename index_type::iterator it = index.find(key);
+     if (it == index.end()) it = index.insert(pair<const Key, version *>(key, nullptr)).first;
+     version *head = it->second;
+     value_version *v;
+     try {
+       v = new value_version(clock + 1, head, value);
+     } catch (...) {
+       if (!head) index.erase(it);
+       throw;
+     }
+     ++clock;
+     if (!value_of(head)) ++live_count;
+     push(it, v);
+   }
+
+   // inserts only if key has no live value; returns whether it did
+   bool insert(const value_type &value) {
+     if (find(value.first)) return false;
+     put(value.first, value.second);
+     return true;
+   }
+
+   bool erase(const Key &key) {
+     typename index_type::iterator it = index.find(key);
+     if (it == index.end() || !value_of(it->second)) return false;
+     version *v = new version(clock + 1, it->second, true);
+     ++clock;
+     --live_count;
+     push(it, v);
+     return true;
+   }
+
+   /**
+    * reclaims every version older than what the oldest live snapshot (or,
+    * without snapshots, the latest state) can see, and drops keys whose
+    * newest reachable version is an erase. O(number of keys).
+    */
+   void gc() {
+     size_t h = horizon();
+     for (typename index_type::iterator it = index.begin(); it != index.end();) {
+       typename index_type::iterator cur = it++;
+       if (!trim(cur->second, h)) index.erase(cur);
+     }
+     gc_threshold = version_total * 2 + 64;
+   }
+
+   template<class F>
+   void for_each(F fn) const {
+     for (typename index_type::const_iterator it = index.cbegin(); it != index.cend(); ++it) {
+       const T *v = value_of(it->second);
+       if (v) fn(it->first, *v);
+     }
+   }
+};
+
+}
+
+#endif
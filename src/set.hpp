@@ -0,0 +1,308 @@
+/**
+* implement containers like std::set and std::multiset
+*/
+#ifndef SJTU_SET_HPP
+#define SJTU_SET_HPP
+
+#include <cstddef>
+#include "map.hpp"
+
+namespace sjtu {
+
+namespace detail {
+
+template<class Key>
+struct set_node : rb_node<set_node<Key>> {
+   Key k;
+   explicit set_node(const Key &key) : k(key) {}
+   const Key &key() const { return k; }
+   size_t copies() const { return 1; }
+};
+
+// equal keys share one node holding the key once plus its multiplicity
+template<class Key>
+struct multiset_node : rb_node<multiset_node<Key>> {
+   Key k;
+   size_t n;
+   explicit multiset_node(const Key &key) : k(key), n(1) {}
+   const Key &key() const { return k; }
+   size_t copies() const { return n; }
+};
+
+/**
+ * the tree shared by set and multiset. Lookups, copying, iteration and
+ * linking live here; the two containers differ only in their node and in
+ * what insert and erase do with a key that is already present.
+ */
+template<class Key, class Node, class Compare>
+class key_tree {
+  protected:
+   typedef rb_tree_core<Node> core;
+
+   Node *root = nullptr;
+   size_t node_count = 0;
+   Compare comp;
+
+   Node *descend(const Key &key, Node *&parent, int &dir) const {
+     return core::descend(root, key, comp, parent, dir);
+   }
+   Node *find_node(const Key &key) const { return core::find(root, key, comp); }
+
+   void clear_node(Node *x) {
+     if (!x) return;
+     clear_node(x->kid(0));
+     clear_node(x->kid(1));
+     delete x;
+   }
+
+   // on a throw the partial copy is freed and the exception passed on
+   Node *clone_subtree(Node *parent, const Node *other) {
+     if (!other) return nullptr;
+     Node *x = new Node(*other);
+     x->parent = parent;
+     x->child[0] = x->child[1] = nullptr;
+     try {
+       x->child[0] = clone_subtree(x, other->kid(0));
+       x->child[1] = clone_subtree(x, other->kid(1));
+     } catch (...) {
+       clear_node(x);
+       throw;
+     }
+     return x;
+   }
+
+   // hangs z in the free slot descend() reported and rebalances
+   void link(Node *z, Node *parent, int dir) {
+     z->parent = parent;
+     if (!parent) root = z;
+     else parent->child[dir] = z;
+     ++node_count;
+     core::insert_fix(root, z);
+   }
+
+   void drop(Node *x) {
+     core::unlink(root, x);
+     --node_count;
+     delete x;
+   }
+
+   void clear_tree() {
+     clear_node(root);
+     root = nullptr;
+     node_count = 0;
+   }
+
+  public:
+   class const_iterator {
+      friend class key_tree;
+     private:
+      const key_tree *owner = nullptr;
+      Node *cur = nullptr;
+      size_t copy = 0; // which of cur->copies() equal keys
+
+      const_iterator(const key_tree *o, Node *c, size_t k) : owner(o), cur(c), copy(k) {}
+
+     public:
+      const_iterator() = default;
+
+      const_iterator operator++(int) {
+        const_iterator tmp = *this;
+        ++(*this);
+        return tmp;
+      }
+      const_iterator &operator++() {
+        if (!owner || !cur) throw invalid_iterator();
+        if (++copy == cur->copies()) {
+          cur = core::next_node(cur);
+          copy = 0;
+        }
+        return *this;
+      }
+      const_iterator operator--(int) {
+        const_iterator tmp = *this;
+        --(*this);
+        return tmp;
+      }
+      const_iterator &operator--() {
+        if (!owner) throw invalid_iterator();
+        if (cur && copy) {
+          --copy;
+          return *this;
+        }
+        Node *prv = cur ? core::prev_node(cur) : core::max_node(owner->root);
+        if (!prv) throw invalid_iterator();
+        cur = prv;
+        copy = prv->copies() - 1;
+        return *this;
+      }
+
+      const Key &operator*() const {
+        if (!cur) throw invalid_iterator();
+        return cur->k;
+      }
+      const Key *operator->() const noexcept { return &cur->k; }
+
+      bool operator==(const const_iterator &rhs) const {
+        return owner == rhs.owner && cur == rhs.cur && copy == rhs.copy;
+      }
+      bool operator!=(const const_iterator &rhs) const { return !(*this == rhs); }
+   };
+
+  protected:
+   const_iterator iter(Node *x, size_t copy = 0) const { return const_iterator(this, x, copy); }
+
+   // the node pos points at, if pos is a dereferenceable iterator of this tree
+   Node *node_of(const const_iterator &pos) const {
+     if (pos.owner != this || pos.cur == nullptr) throw invalid_iterator();
+     return pos.cur;
+   }
+
+  public:
+   key_tree() = default;
+
+   key_tree(const key_tree &other) : root(nullptr), node_count(0), comp(other.comp) {
+     root = clone_subtree(nullptr, other.root);
+     node_count = other.node_count;
+   }
+
+   // copies first, so a throw leaves this tree as it was
+   key_tree &operator=(const key_tree &other) {
+     if (this == &other) return *this;
+     Node *fresh = clone_subtree(nullptr, other.root);
+     clear_node(root);
+     root = fresh;
+     node_count = other.node_count;
+     comp = other.comp;
+     return *this;
+   }
+
+   ~key_tree() { clear_node(root); }
+
+   const_iterator begin() const { return iter(core::min_node(root)); }
+   const_iterator end() const { return iter(nullptr); }
+   const_iterator cbegin() const { return begin(); }
+   const_iterator cend() const { return end(); }
+
+   const_iterator find(const Key &key) const { return iter(find_node(key)); }
+};
+
+}
+
+/**
+ * key-only red-black tree on the same rb_tree_core as sjtu::map. A node is
+ * the key plus colour and three links, with no value slot, so set<int>
+ * nodes are 32 bytes where map<int, bool> nodes are 40.
+ */
+template<
+   class Key,
+   class Compare = std::less<Key>
+   > class set : public detail::key_tree<Key, detail::set_node<Key>, Compare> {
+  private:
+   typedef detail::set_node<Key> Node;
+   typedef detail::key_tree<Key, Node, Compare> tree;
+
+  public:
+   typedef typename tree::const_iterator const_iterator;
+   typedef const_iterator iterator;
+
+   bool empty() const { return this->node_count == 0; }
+   size_t size() const { return this->node_count; }
+
+   void clear() { this->clear_tree(); }
+
+   pair<const_iterator, bool> insert(const Key &key) {
+     Node *parent;
+     int dir;
+     if (Node *x = this->descend(key, parent, dir)) return pair<const_iterator, bool>(this->iter(x), false);
+     Node *z = new Node(key);
+     this->link(z, parent, dir);
+     return pair<const_iterator, bool>(this->iter(z), true);
+   }
+
+   void erase(const_iterator pos) { this->drop(this->node_of(pos)); }
+
+   size_t erase(const Key &key) {
+     Node *x = this->find_node(key);
+     if (!x) return 0;
+     this->drop(x);
+     return 1;
+   }
+
+   size_t count(const Key &key) const { return this->find_node(key) ? 1 : 0; }
+};
+
+/**
+ * counted multiset: equal keys share one node holding the key once plus
+ * its multiplicity, so count() is O(log n) and duplicates cost no memory.
+ * Iteration still visits every copy.
+ */
+template<
+   class Key,
+   class Compare = std::less<Key>
+   > class multiset : public detail::key_tree<Key, detail::multiset_node<Key>, Compare> {
+  private:
+   typedef detail::multiset_node<Key> Node;
+   typedef detail::key_tree<Key, Node, Compare> tree;
+
+   size_t elem_count = 0;
+
+  public:
+   typedef typename tree::const_iterator const_iterator;
+   typedef const_iterator iterator;
+
+   bool empty() const { return elem_count == 0; }
+   size_t size() const { return elem_count; }
+   size_t distinct_count() const { return this->node_count; }
+
+   void clear() {
+     this->clear_tree();
+     elem_count = 0;
+   }
+
+   // adds one copy of key; the iterator points at that (last) copy
+   const_iterator insert(const Key &key) {
+     Node *parent;
+     int dir;
+     if (Node *x = this->descend(key, parent, dir)) {
+       ++elem_count;
+       return this->iter(x, x->n++);
+     }
+     Node *z = new Node(key);
+     this->link(z, parent, dir);
+     ++elem_count;
+     return this->iter(z);
+   }
+
+   // removes one copy; iterators to the last copy of that key go stale
+   void erase(const_iterator pos) {
+     Node *x = this->node_of(pos);
+     --elem_count;
+     if (--x->n) return;
+     this->drop(x);
+   }
+
+   // removes every copy of key; returns how many
+   size_t erase(const Key &key) {
+     Node *x = this->find_node(key);
+     if (!x) return 0;
+     size_t n = x->n;
+     elem_count -= n;
+     this->drop(x);
+     return n;
+   }
+
+   size_t count(const Key &key) const {
+     Node *x = this->find_node(key);
+     return x ? x->n : 0;
+   }
+
+   pair<const_iterator, const_iterator> equal_range(const Key &key) const {
+     Node *x = this->find_node(key);
+     if (!x) return pair<const_iterator, const_iterator>(this->end(), this->end());
+     return pair<const_iterator, const_iterator>(this->iter(x), this->iter(tree::core::next_node(x)));
+   }
+};
+
+}
+
+#endif
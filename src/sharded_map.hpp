@@ -0,0 +1,317 @@
+/**
+* range-partitioned map built from sjtu::map shards
+*/
+#ifndef SJTU_SHARDED_MAP_HPP
+#define SJTU_SHARDED_MAP_HPP
+
+#include <cstddef>
+#include "map.hpp"
+
+namespace sjtu {
+
+/**
+ * in-process stand-in for a remote shard server. Every call takes a shard
+ * id and does the work a remote host would do on its side of the wire, so
+ * sharded_map only ever talks to shards through this interface.
+ */
+template<
+   class Key,
+   class T,
+   class Compare = std::less<Key>
+   > class local_shard_host {
+  public:
+   typedef map<Key, T, Compare> shard_type;
+   typedef pair<const Key, T> value_type;
+
+  private:
+   shard_type **slots = nullptr;
+   size_t slot_cap = 0;
+
+   shard_type &slot(size_t id) const {
+     if (id >= slot_cap || !slots[id]) throw index_out_of_bound();
+     return *slots[id];
+   }
+
+  public:
+   local_shard_host() = default;
+   local_shard_host(const local_shard_host &) = delete;
+   local_shard_host &operator=(const local_shard_host &) = delete;
+
+   ~local_shard_host() {
+     for (size_t i = 0; i < slot_cap; ++i) delete slots[i];
+     delete[] slots;
+   }
+
+   size_t create() {
+     size_t id = 0;
+     while (id < slot_cap && slots[id]) ++id;
+     if (id == slot_cap) {
+       size_t cap = slot_cap ? slot_cap * 2 : 8;
+       shard_type **s = new shard_type *[cap];
+       for (size_t i = 0; i < cap; ++i) s[i] = i < slot_cap ? slots[i] : nullptr;
+       delete[] slots;
+       slots = s;
+       slot_cap = cap;
+     }
+     slots[id] = new shard_type();
+     return id;
+   }
+
+   void destroy(size_t id) {
+     slot(id);
+     delete slots[id];
+     slots[id] = nullptr;
+   }
+
+   size_t size(size_t id) const { return slot(id).size(); }
+
+   T *find(size_t id, const Key &key) {
+     shard_type &s = slot(id);
+     typename shard_type::iterator it = s.find(key);
+     return it == s.end() ? nullptr : &it->second;
+   }
+
+   bool insert(size_t id, const value_type &value) { return slot(id).insert(value).second; }
+
+   bool erase(size_t id, const Key &key) {
+     shard_type &s = slot(id);
+     typename shard_type::iterator it = s.find(key);
+     if (it == s.end()) return false;
+     s.erase(it);
+     return true;
+   }
+
+   void clear(size_t id) { slot(id).clear(); }
+
+   // key of the element at position size() / 2
+   Key median(size_t id) const {
+     const shard_type &s = slot(id);
+     if (s.empty()) throw container_is_empty();
+     typename shard_type::const_iterator it = s.cbegin();
+     for (size_t i = s.size() / 2; i; --i) ++it;
+     return it->first;
+   }
+
+   // moves keys >= key of shard id into the (empty) shard upper_id
+   void split(size_t id, const Key &key, size_t upper_id) { slot(id).split(key, slot(upper_id)); }
+
+   // appends shard upper_id to shard id and destroys upper_id
+   void merge(size_t id, size_t upper_id) {
+     slot(id).join(slot(upper_id));
+     destroy(upper_id);
+   }
+
+   template<class F>
+   void for_each(size_t id, F &fn) const {
+     const shard_type &s = slot(id);
+     for (typename shard_type::const_iterator it = s.cbegin(); it != s.cend(); ++it) fn(*it);
+   }
+};
+
+/**
+ * map partitioned into key ranges, each served by one shard on a Host.
+ * A routing table of lower bounds sends every operation to its shard.
+ * Shards that grow past max_shard_size, or that receive hot_ops operations
+ * within one epoch of epoch_ops operations, are split at their median;
+ * adjacent shards that both stay below cold_ops and fit together in half
+ * a shard are merged at the end of the epoch.
+ */
+template<
+   class Key,
+   class T,
+   class Compare = std::less<Key>,
+   class Host = local_shard_host<Key, T, Compare>
+   > class sharded_map {
+  public:
+   typedef pair<const Key, T> value_type;
+
+   struct policy {
+     size_t max_shard_size = 1 << 16;
+     size_t hot_ops = 1 << 15;
+     size_t cold_ops = 1 << 8;
+     size_t epoch_ops = 1 << 17;
+   };
+
+  private:
+   struct route {
+     Key *lower; // nullptr for the first shard
+     size_t shard;
+     size_t ops;
+   };
+
+   Host *host;
+   bool own_host;
+   policy pol;
+   Compare comp;
+   route *routes = nullptr;
+   size_t route_n = 0, route_cap = 0;
+   size_t elem_count = 0;
+   size_t epoch_left;
+
+   // index of the route whose range contains key
+   size_t locate(const Key &key) const {
+     size_t l = 1, r = route_n;
+     while (l < r) {
+       size_t mid = (l + r) / 2;
+       if (comp(key, *routes[mid].lower)) r = mid;
+       else l = mid + 1;
+     }
+     return l - 1;
+   }
+
+   void insert_route(size_t pos, Key *lower, size_t shard) {
+     if (route_n == route_cap) {
+       size_t cap = route_cap ? route_cap * 2 : 8;
+       route *r = new route[cap];
+       for (size_t i = 0; i < route_n; ++i) r[i] = routes[i];
+       delete[] routes;
+       routes = r;
+       route_cap = cap;
+     }
+     for (size_t i = route_n; i > pos; --i) routes[i] = routes[i - 1];
+     routes[pos].lower = lower;
+     routes[pos].shard = shard;
+     routes[pos].ops = 0;
+     ++route_n;
+   }
+
+   void remove_route(size_t pos) {
+     delete routes[pos].lower;
+     for (size_t i = pos; i + 1 < route_n; ++i) routes[i] = routes[i + 1];
+     --route_n;
+   }
+
+   void split_shard(size_t i) {
+     Key *lower = new Key(host->median(routes[i].shard));
+     size_t upper = 0;
+     try {
+       upper = host->create();
+       insert_route(i + 1, lower, upper);
+     } catch (...) {
+       delete lower;
+       throw;
+     }
+     host->split(routes[i].shard, *lower, upper);
+     routes[i].ops /= 2;
+     routes[i + 1].ops = routes[i].ops;
+   }
+
+   void merge_shards(size_t i) {
+     host->merge(routes[i].shard, routes[i + 1].shard);
+     routes[i].ops += routes[i + 1].ops;
+     remove_route(i + 1);
+   }
+
+   void tick() {
+     if (--epoch_left == 0) rebalance();
+   }
+
+   void init() {
+     epoch_left = pol.epoch_ops ? pol.epoch_ops : 1;
+     insert_route(0, nullptr, host->create());
+   }
+
+  public:
+   explicit sharded_map(const policy &p = policy())
+       : host(new Host()), own_host(true), pol(p) { init(); }
+
+   explicit sharded_map(Host &h, const policy &p = policy())
+       : host(&h), own_host(false), pol(p) { init(); }
+
+   sharded_map(const sharded_map &) = delete;
+   sharded_map &operator=(const sharded_map &) = delete;
+
+   ~sharded_map() {
+     for (size_t i = 0; i < route_n; ++i) {
+       delete routes[i].lower;
+       host->destroy(routes[i].shard);
+     }
+     delete[] routes;
+     if (own_host) delete host;
+   }
+
+   size_t size() const { return elem_count; }
+   bool empty() const { return elem_count == 0; }
+   size_t shard_count() const { return route_n; }
+
+   T *find(const Key &key) {
+     size_t i = locate(key);
+     ++routes[i].ops;
+     T *res = host->find(routes[i].shard, key);
+     tick();
+     return res;
+   }
+
+   T &at(const Key &key) {
+     T *res = find(key);
+     if (!res) throw index_out_of_bound();
+     return *res;
+   }
+
+   size_t count(const Key &key) { return find(key) ? 1 : 0; }
+
+   bool insert(const value_type &value) {
+     size_t i = locate(value.first);
+     ++routes[i].ops;
+     if (!host->insert(routes[i].shard, value)) {
+       tick();
+       return false;
+     }
+     ++elem_count;
+     size_t n = host->size(routes[i].shard);
+     if (n > pol.max_shard_size && n >= 2) split_shard(i);
+     tick();
+     return true;
+   }
+
+   bool erase(const Key &key) {
+     size_t i = locate(key);
+     ++routes[i].ops;
+     bool erased = host->erase(routes[i].shard, key);
+     if (erased) --elem_count;
+     tick();
+     return erased;
+   }
+
+   void clear() {
+     while (route_n > 1) {
+       host->destroy(routes[route_n - 1].shard);
+       remove_route(route_n - 1);
+     }
+     host->clear(routes[0].shard);
+     routes[0].ops = 0;
+     elem_count = 0;
+   }
+
+   /**
+    * ends the current epoch: splits hot shards, merges adjacent cold ones
+    * and resets the per-shard operation counters. Called automatically
+    * every epoch_ops operations.
+    */
+   void rebalance() {
+     for (size_t i = 0; i < route_n; ++i) {
+       if (routes[i].ops >= pol.hot_ops && host->size(routes[i].shard) >= 2) {
+         split_shard(i);
+         ++i;
+       }
+     }
+     for (size_t i = 0; i + 1 < route_n;) {
+       if (routes[i].ops < pol.cold_ops && routes[i + 1].ops < pol.cold_ops &&
+           host->size(routes[i].shard) + host->size(routes[i + 1].shard) <= pol.max_shard_size / 2)
+         merge_shards(i);
+       else ++i;
+     }
+     for (size_t i = 0; i < route_n; ++i) routes[i].ops = 0;
+     epoch_left = pol.epoch_ops ? pol.epoch_ops : 1;
+   }
+
+   // calls fn(const value_type &) on every element in key order
+   template<class F>
+   void for_each(F fn) const {
+     for (size_t i = 0; i < route_n; ++i) host->for_each(routes[i].shard, fn);
+   }
+};
+
+}
+
+#endif
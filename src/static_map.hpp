@@ -0,0 +1,95 @@
+/**
+* immutable map built at compile time
+*/
+#ifndef SJTU_STATIC_MAP_HPP
+#define SJTU_STATIC_MAP_HPP
+
+#include <cstddef>
+#include <functional>
+#include "exceptions.hpp"
+
+namespace sjtu {
+
+/**
+ * frozen lookup table of exactly N entries. The constructor sorts its
+ * initializer in a constant expression, so a constexpr static_map is
+ * laid out in read-only data with no start-up cost, and find()/at()/count()
+ * are usable in constant expressions too. Key and T must be literal,
+ * default constructible and copy assignable; Compare must be constexpr.
+ *
+ *   constexpr sjtu::static_map<int, char, 3> table({{3, 'c'}, {1, 'a'}, {2, 'b'}});
+ *   static_assert(table.at(2) == 'b', "");
+ */
+template<
+   class Key,
+   class T,
+   size_t N,
+   class Compare = std::less<Key>
+   > class static_map {
+  public:
+   // sjtu::pair has no constexpr constructors, hence a plain aggregate
+   struct value_type {
+     Key first;
+     T second;
+   };
+   typedef const value_type *const_iterator;
+
+  private:
+   value_type items[N > 0 ? N : 1];
+   Compare comp;
+
+   // first index whose key is not less than key
+   constexpr size_t lower(const Key &key) const {
+     size_t lo = 0, len = N;
+     while (len > 0) {
+       size_t half = len / 2;
+       if (comp(items[lo + half].first, key)) {
+         lo += half + 1;
+         len -= half + 1;
+       } else {
+         len = half;
+       }
+     }
+     return lo;
+   }
+
+  public:
+   // duplicate keys are rejected: a compile error when built constexpr
+   constexpr explicit static_map(const value_type (&init)[N > 0 ? N : 1], const Compare &c = Compare())
+       : items(), comp(c) {
+     for (size_t i = 0; i < N; ++i) {
+       size_t j = i;
+       while (j > 0 && comp(init[i].first, items[j - 1].first)) {
+         items[j] = items[j - 1];
+         --j;
+       }
+       if (j > 0 && !comp(items[j - 1].first, init[i].first)) throw runtime_error();
+       items[j] = init[i];
+     }
+   }
+
+   constexpr size_t size() const { return N; }
+   constexpr bool empty() const { return N == 0; }
+
+   constexpr const_iterator begin() const { return items; }
+   constexpr const_iterator end() const { return items + N; }
+   constexpr const_iterator cbegin() const { return begin(); }
+   constexpr const_iterator cend() const { return end(); }
+
+   constexpr const_iterator find(const Key &key) const {
+     size_t i = lower(key);
+     return i < N && !comp(key, items[i].first) ? items + i : end();
+   }
+
+   constexpr size_t count(const Key &key) const { return find(key) != end() ? 1 : 0; }
+
+   constexpr const T &at(const Key &key) const {
+     const_iterator it = find(key);
+     if (it == end()) throw index_out_of_bound();
+     return it->second;
+   }
+};
+
+}
+
+#endif
